@@ -0,0 +1,210 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/AlleleMatrix.h"
+#include <algorithm>
+
+using namespace::std;
+
+static const int tileRows = 256; // rows per tile when transposing
+
+AlleleMatrix::AlleleMatrix()
+{
+	clear();
+}
+
+void AlleleMatrix::addRow(const char * alleles, int length)
+{
+	if ( rowCount == 0 )
+	{
+		columnCount = length;
+		rowBytes = bits == 4 ? (columnCount + 1) / 2 : columnCount;
+	}
+	
+	// make sure every character has a code before packing
+	
+	for ( int i = 0; i < columnCount && i < length; i++ )
+	{
+		unsigned char allele = alleles[i];
+		
+		if ( codes[allele] == -1 )
+		{
+			if ( alphabetSize == 16 )
+			{
+				widen();
+			}
+			
+			alphabet[alphabetSize] = allele;
+			codes[allele] = alphabetSize;
+			alphabetSize++;
+		}
+	}
+	
+	data.resize(data.size() + rowBytes, 0);
+	
+	unsigned char * row = data.data() + rowCount * rowBytes;
+	
+	for ( int i = 0; i < columnCount && i < length; i++ )
+	{
+		int code = codes[(unsigned char)alleles[i]];
+		
+		if ( bits == 4 )
+		{
+			row[i / 2] |= i & 1 ? code << 4 : code;
+		}
+		else
+		{
+			row[i] = code;
+		}
+	}
+	
+	rowCount++;
+}
+
+void AlleleMatrix::appendRows(const AlleleMatrix & other)
+{
+	if ( other.rowCount == 0 )
+	{
+		return;
+	}
+	
+	if ( rowCount == 0 )
+	{
+		*this = other;
+		return;
+	}
+	
+	// Packed rows can be copied as they are if the other matrix has the same
+	// layout and its codes mean the same characters here, which is the usual
+	// case since every matrix starts with the same alphabet.
+	
+	bool compatible = bits == other.bits && columnCount == other.columnCount;
+	
+	for ( int i = 0; compatible && i < other.alphabetSize; i++ )
+	{
+		compatible = codes[(unsigned char)other.alphabet[i]] == i;
+	}
+	
+	if ( compatible )
+	{
+		data.insert(data.end(), other.data.begin(), other.data.end());
+		rowCount += other.rowCount;
+		return;
+	}
+	
+	string row;
+	
+	for ( int i = 0; i < other.rowCount; i++ )
+	{
+		other.getRow(i, row);
+		addRow(row.c_str(), row.length());
+	}
+}
+
+void AlleleMatrix::clear()
+{
+	const char * initial = "ACGTN-";
+	
+	columnCount = 0;
+	rowCount = 0;
+	bits = 4;
+	rowBytes = 0;
+	data.clear();
+	
+	for ( int i = 0; i < 256; i++ )
+	{
+		alphabet[i] = 0;
+		codes[i] = -1;
+	}
+	
+	for ( alphabetSize = 0; initial[alphabetSize]; alphabetSize++ )
+	{
+		alphabet[alphabetSize] = initial[alphabetSize];
+		codes[(unsigned char)initial[alphabetSize]] = alphabetSize;
+	}
+}
+
+void AlleleMatrix::getColumn(int column, string & alleles) const
+{
+	alleles.resize(rowCount);
+	
+	for ( int i = 0; i < rowCount; i++ )
+	{
+		alleles[i] = getAllele(i, column);
+	}
+}
+
+void AlleleMatrix::getColumns(int columnFirst, int count, const vector<int> & rows, vector<string> & columns) const
+{
+	// Blocked transpose: reading a column straight down touches a cache line
+	// per row, so work through tiles of rows small enough that the lines
+	// they share stay cached while every requested column is filled in.
+	
+	columns.resize(count);
+	
+	for ( int i = 0; i < count; i++ )
+	{
+		columns[i].resize(rows.size());
+	}
+	
+	for ( int tile = 0; tile < rows.size(); tile += tileRows )
+	{
+		int tileEnd = min(tile + tileRows, (int)rows.size());
+		
+		for ( int i = 0; i < count; i++ )
+		{
+			char * column = &columns[i][0];
+			
+			for ( int j = tile; j < tileEnd; j++ )
+			{
+				column[j] = alphabet[getCode(rows[j], columnFirst + i)];
+			}
+		}
+	}
+}
+
+void AlleleMatrix::getRow(int row, string & alleles) const
+{
+	alleles.resize(columnCount);
+	
+	for ( int i = 0; i < columnCount; i++ )
+	{
+		alleles[i] = getAllele(row, i);
+	}
+}
+
+void AlleleMatrix::permuteRows(const vector<int> & order)
+{
+	vector<unsigned char> dataNew(order.size() * rowBytes);
+	
+	for ( int i = 0; i < order.size(); i++ )
+	{
+		copy(data.begin() + order[i] * rowBytes, data.begin() + (order[i] + 1) * rowBytes, dataNew.begin() + i * rowBytes);
+	}
+	
+	data.swap(dataNew);
+	rowCount = order.size();
+}
+
+void AlleleMatrix::widen()
+{
+	// more than 16 distinct characters; switch to a byte per allele
+	
+	size_t rowBytesNew = columnCount;
+	vector<unsigned char> dataNew(rowCount * rowBytesNew);
+	
+	for ( int i = 0; i < rowCount; i++ )
+	{
+		for ( int j = 0; j < columnCount; j++ )
+		{
+			dataNew[i * rowBytesNew + j] = getCode(i, j);
+		}
+	}
+	
+	data.swap(dataNew);
+	rowBytes = rowBytesNew;
+	bits = 8;
+}
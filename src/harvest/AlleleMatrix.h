@@ -0,0 +1,69 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef AlleleMatrix_h
+#define AlleleMatrix_h
+
+#include <string>
+#include <vector>
+
+// Alleles of all variants (rows) for all tracks (columns), packed into one
+// contiguous row-major array. Each allele is a code into a per-matrix
+// alphabet, which starts as A, C, G, T, N and - and grows as other characters
+// are seen. Codes take 4 bits while the alphabet has at most 16 characters,
+// and 8 bits after that, so any characters round-trip exactly. Rows start on
+// byte boundaries.
+//
+class AlleleMatrix
+{
+public:
+	
+	AlleleMatrix();
+	
+	void addRow(const char * alleles, int length); // the first row sets the column count
+	void appendRows(const AlleleMatrix & other);
+	void clear();
+	char getAllele(int row, int column) const;
+	size_t getByteCount() const;
+	int getColumnCount() const;
+	void getColumn(int column, std::string & alleles) const;
+	void getColumns(int columnFirst, int count, const std::vector<int> & rows, std::vector<std::string> & columns) const; // track-major view of the given rows
+	void getRow(int row, std::string & alleles) const;
+	int getRowCount() const;
+	void permuteRows(const std::vector<int> & order); // row i becomes former row order[i]
+	
+private:
+	
+	int getCode(int row, int column) const;
+	void widen();
+	
+	int columnCount;
+	int rowCount;
+	int bits; // per allele; 4 or 8
+	size_t rowBytes;
+	std::vector<unsigned char> data;
+	char alphabet[256]; // by code
+	short codes[256]; // by character; -1 if not in the alphabet yet
+	int alphabetSize;
+};
+
+inline int AlleleMatrix::getCode(int row, int column) const
+{
+	if ( bits == 4 )
+	{
+		unsigned char pair = data[row * rowBytes + column / 2];
+		return column & 1 ? pair >> 4 : pair & 0xf;
+	}
+	
+	return data[row * rowBytes + column];
+}
+
+inline char AlleleMatrix::getAllele(int row, int column) const { return alphabet[getCode(row, column)]; }
+inline size_t AlleleMatrix::getByteCount() const { return data.size(); }
+inline int AlleleMatrix::getColumnCount() const { return columnCount; }
+inline int AlleleMatrix::getRowCount() const { return rowCount; }
+
+#endif
@@ -8,28 +8,174 @@
 #include <fstream>
 #include "parse.h"
 #include <algorithm>
+#include <string.h>
+#include "harvest/ThreadPool.h"
 
 using namespace std;
 
+static const size_t stringBlockSize = 1 << 16;
+
 bool annotationLessThan(const Annotation & a, const Annotation & b)
 {
 	return a.start < b.start;
 }
 
+bool regionLessThan(const AnnotationRegion & a, const AnnotationRegion & b)
+{
+	return a.start < b.start;
+}
+
+// Regions of a GenBank feature location, such as "complement(join(<1..200,
+// 300..>450))", 0-based in the record. Ranges in other records (e.g.
+// "J00194.1:100..202") are skipped.
+//
+void parseLocation(const string & location, vector<AnnotationRegion> & regions, bool & reverse)
+{
+	regions.clear();
+	reverse = location.find("complement(") != string::npos;
+	
+	size_t start = 0;
+	
+	while ( start < location.length() )
+	{
+		size_t end = location.find(',', start);
+		
+		if ( end == string::npos )
+		{
+			end = location.length();
+		}
+		
+		// drop operators and partial-range markers
+		
+		string range = location.substr(start, end - start);
+		size_t open = range.rfind('(');
+		
+		if ( open != string::npos )
+		{
+			range.erase(0, open + 1);
+		}
+		
+		range.erase(remove_if(range.begin(), range.end(), [](char c) { return c == ')' || c == '<' || c == '>' || c == ' '; }), range.end());
+		
+		if ( range.length() && range.find(':') == string::npos )
+		{
+			AnnotationRegion region;
+			size_t dots = range.find("..");
+			
+			region.start = atoi(range.c_str()) - 1;
+			region.end = dots == string::npos ? region.start : atoi(range.c_str() + dots + 2) - 1;
+			regions.push_back(region);
+		}
+		
+		start = end + 1;
+	}
+}
+
+AnnotationList::AnnotationList()
+{
+	indexLevel = -1;
+	stringBlockUsed = 0;
+}
+
 void AnnotationList::clear()
 {
 	annotations.clear();
+	regions.clear();
+	stringBlocks.clear();
+	stringBlockUsed = 0;
+	strings.clear();
+	index();
+}
+
+void AnnotationList::getAnnotationsOverlapping(int start, int end, vector<int> & indices) const
+{
+	struct Node
+	{
+		int level;
+		int index;
+		bool leftDone;
+	};
+	
+	Node stack[64];
+	int depth = 0;
+	int count = annotations.size();
+	
+	indices.clear();
+	
+	if ( indexLevel < 0 )
+	{
+		return;
+	}
+	
+	stack[depth].level = indexLevel;
+	stack[depth].index = (1 << indexLevel) - 1;
+	stack[depth].leftDone = false;
+	depth++;
+	
+	// Nodes are visited in order, so indices are added in ascending order.
+	// Node indices past the end are virtual; their subtrees may still hold
+	// annotations on the left.
+	
+	while ( depth > 0 )
+	{
+		Node node = stack[--depth];
+		
+		if ( node.level <= 3 )
+		{
+			// small subtree; check every annotation in it
+			
+			int first = node.index >> node.level << node.level;
+			int last = min(first + (1 << (node.level + 1)) - 1, count);
+			
+			for ( int i = first; i < last && annotations[i].start <= end; i++ )
+			{
+				if ( annotations[i].end >= start )
+				{
+					indices.push_back(i);
+				}
+			}
+		}
+		else if ( ! node.leftDone )
+		{
+			int left = node.index - (1 << (node.level - 1));
+			
+			stack[depth] = node;
+			stack[depth].leftDone = true;
+			depth++;
+			
+			if ( left >= count || endsMax[left] >= start )
+			{
+				stack[depth].level = node.level - 1;
+				stack[depth].index = left;
+				stack[depth].leftDone = false;
+				depth++;
+			}
+		}
+		else if ( node.index < count && annotations[node.index].start <= end )
+		{
+			if ( annotations[node.index].end >= start )
+			{
+				indices.push_back(node.index);
+			}
+			
+			stack[depth].level = node.level - 1;
+			stack[depth].index = node.index + (1 << (node.level - 1));
+			stack[depth].leftDone = false;
+			depth++;
+		}
+	}
 }
 
 void AnnotationList::initFromCapnp(const capnp::Harvest::Reader & harvestReader, const ReferenceList & referenceList)
 {
 	int sequence = 0;
 	int offset = 0;
+	vector<AnnotationRegion> regionsNew;
 	
 	auto annotationListReader = harvestReader.getAnnotationList();
 	auto annotationsReader = annotationListReader.getAnnotations();
 	
-	annotations.resize(0);
+	clear();
 	annotations.resize(annotationsReader.size());
 	
 	for ( int i = 0; i < annotations.size(); i++ )
@@ -38,13 +184,13 @@ void AnnotationList::initFromCapnp(const capnp::Harvest::Reader & harvestReader,
 		
 		auto annotationReader = annotationsReader[i];
 		
-		while ( sequence < annotationReader.getSequence() && sequence < referenceList.getReferenceCount() )
+		sequence = annotationReader.getSequence();
+		
+		if ( sequence < referenceList.getReferenceCount() )
 		{
-			offset += referenceList.getReference(sequence).sequence.length();
-			sequence++;
+			offset = referenceList.getConcatenatedPosition(sequence, 0);
 		}
-		
-		if ( sequence == referenceList.getReferenceCount() )
+		else
 		{
 			offset = 0;
 			//printf("ERROR: sequence %d not found in reference or annotation out of order in protobuf.\n", msgAnn.sequence());
@@ -52,48 +198,362 @@ void AnnotationList::initFromCapnp(const capnp::Harvest::Reader & harvestReader,
 		}
 		
 		auto regionsReader = annotationReader.getRegions();
-		auto regionReader = regionsReader[0];
 		
-		// TODO: multiple regions
+		regionsNew.resize(regionsReader.size());
+		
+		for ( int j = 0; j < regionsNew.size(); j++ )
+		{
+			regionsNew[j].start = regionsReader[j].getStart() + offset;
+			regionsNew[j].end = regionsReader[j].getEnd() + offset;
+		}
 		
-		annotation.start = regionReader.getStart() + offset;
-		annotation.end = regionReader.getEnd() + offset;
+		setRegions(annotation, regionsNew);
 		annotation.reverse = annotationReader.getReverse();
-		annotation.name = annotationReader.getName();
-		annotation.locus = annotationReader.getLocus();
-		annotation.description = annotationReader.getDescription();
-		annotation.feature = annotationReader.getFeature();
+		annotation.name = addString(annotationReader.getName().cStr(), annotationReader.getName().size());
+		annotation.locus = addString(annotationReader.getLocus().cStr(), annotationReader.getLocus().size());
+		annotation.description = addString(annotationReader.getDescription().cStr(), annotationReader.getDescription().size());
+		annotation.feature = addString(annotationReader.getFeature().cStr(), annotationReader.getFeature().size());
+		annotation.geneticCode = annotationReader.getGeneticCode();
 		
-		//printf("%s\t%d\t%d\t%d\t%c\t%s\t%s\n", annotation.locus.c_str(), msgAnn.sequence(), annotation.start, annotation.end, annotation.reverse ? '-' : '+', annotation.name.c_str(), annotation.description.c_str());
 	}
 	
 	// older capnp files might not be sorted
 	//
 	sort(annotations.begin(), annotations.end(), annotationLessThan);
+	index();
 }
 
 void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenceList, bool useSeq)
 {
-	ifstream in(file);
-	char * line = new char[1 << 20];
-	Annotation * annotation = 0;
-	int offset;
+	initFromGenbank(vector<const char *>(1, file), referenceList, useSeq);
+}
+
+void AnnotationList::initFromGenbank(const vector<const char *> & files, ReferenceList & referenceList, bool useSeq, int threads)
+{
+	// Files are parsed concurrently, knowing nothing of the reference list;
+	// records are then placed on references in file order, so references
+	// taken from sequence (and errors) are the same as when loading serially.
+	
+	vector<vector<GenbankRecord> > recordsByFile(files.size());
 	
-	while ( ! in.eof() )
 	{
-		string locus;
-		string definition;
+		ThreadPool threadPool(min(threads, int(files.size())));
 		
-		if ( useSeq )
+		for ( int i = 0; i < files.size(); i++ )
 		{
-			offset = 0;
+			threadPool.run([&, i]() { parseGenbank(files[i], useSeq, recordsByFile[i]); });
+		}
+		
+		threadPool.wait();
+	}
+	
+	for ( int i = 0; i < files.size(); i++ )
+	{
+		long int offset = 0;
+		
+		for ( int j = 0; j < recordsByFile[i].size(); j++ )
+		{
+			GenbankRecord & record = recordsByFile[i][j];
 			
-			for ( int i = 0; i < referenceList.getReferenceCount(); i++ )
+			if ( useSeq )
 			{
-				offset += referenceList.getReference(i).sequence.length();
+				offset = referenceList.getConcatenatedPosition(referenceList.getReferenceCount(), 0);
 			}
+			else if ( record.version )
+			{
+				if ( record.accession.empty() )
+				{
+					throw NoAccException(files[i]);
+				}
+				
+				offset = referenceList.getConcatenatedPosition(referenceList.getReferenceSequenceFromAcc(record.accession.c_str()), 0);
+			}
+			
+			// the record's features are sorted, so merge them as a run
+			
+			size_t first = annotations.size();
+			
+			for ( int k = 0; k < record.features.size(); k++ )
+			{
+				addFeature(record.features[k], offset);
+			}
+			
+			inplace_merge(annotations.begin(), annotations.begin() + first, annotations.end(), annotationLessThan);
+			
+			if ( useSeq && record.complete )
+			{
+				if ( record.sequence.length() )
+				{
+					referenceList.addReference(record.locus, record.definition, record.sequence);
+				}
+				else
+				{
+					clear();
+					throw NoSequenceException(files[i]);
+				}
+			}
+		}
+		
+		recordsByFile[i].clear();
+	}
+	
+	index();
+}
+
+void AnnotationList::initFromProtocolBuffer(const Harvest::AnnotationList & msg, const ReferenceList & referenceList)
+{
+	int sequence = 0;
+	int offset = 0;
+	vector<AnnotationRegion> regionsNew;
+	
+	clear();
+	annotations.resize(msg.annotations_size());
+	
+	for ( int i = 0; i < msg.annotations_size(); i++ )
+	{
+		Annotation & annotation = annotations.at(i);
+		
+		const Harvest::AnnotationList::Annotation & msgAnn = msg.annotations(i);
+		
+		sequence = msgAnn.sequence();
+		
+		if ( sequence < referenceList.getReferenceCount() )
+		{
+			offset = referenceList.getConcatenatedPosition(sequence, 0);
+		}
+		else
+		{
+			offset = 0;
+			//printf("ERROR: sequence %d not found in reference or annotation out of order in protobuf.\n", msgAnn.sequence());
+			//exit(1);
+		}
+		
+		regionsNew.resize(msgAnn.regions_size());
+		
+		for ( int j = 0; j < regionsNew.size(); j++ )
+		{
+			regionsNew[j].start = msgAnn.regions(j).start() + offset;
+			regionsNew[j].end = msgAnn.regions(j).end() + offset;
+		}
+		
+		setRegions(annotation, regionsNew);
+		annotation.reverse = msgAnn.reverse();
+		annotation.name = addString(msgAnn.name().data(), msgAnn.name().length());
+		annotation.locus = addString(msgAnn.locus().data(), msgAnn.locus().length());
+		annotation.description = addString(msgAnn.description().data(), msgAnn.description().length());
+		annotation.feature = addString(msgAnn.feature().data(), msgAnn.feature().length());
+		annotation.geneticCode = msgAnn.genetic_code();
+	}
+	
+	index(); // written sorted by start
+}
+
+void AnnotationList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder, const ReferenceList & referenceList) const
+{
+	int sequence = 0;
+	int offset = 0;
+	int offsetEnd = referenceList.getReference(0).sequence.length();
+	
+	auto annotationListBuilder = harvestBuilder.initAnnotationList();
+	auto annotationsBuilder = annotationListBuilder.initAnnotations(annotations.size());
+	
+	for ( int i = 0; i < annotations.size(); i++ )
+	{
+		const Annotation & annotation = annotations.at(i);
+		
+		auto annotationBuilder = annotationsBuilder[i];
+		
+		while ( annotation.start >= offsetEnd && sequence < referenceList.getReferenceCount() - 1 )
+		{
+			sequence++;
+			offset = offsetEnd;
+			offsetEnd += referenceList.getReference(sequence).sequence.length();
+		}
+		
+		annotationBuilder.setSequence(sequence);
+		
+		auto regionsBuilder = annotationBuilder.initRegions(annotation.regionCount);
+		
+		for ( int j = 0; j < annotation.regionCount; j++ )
+		{
+			auto regionBuilder = regionsBuilder[j];
+			const AnnotationRegion & region = regions[annotation.regionFirst + j];
+			
+			regionBuilder.setStart(region.start - offset);
+			regionBuilder.setEnd(region.end - offset);
+		}
+		
+		// pooled strings are null-terminated
+		//
+		annotationBuilder.setReverse(annotation.reverse);
+		annotationBuilder.setName(annotation.name.data());
+		annotationBuilder.setLocus(annotation.locus.data());
+		annotationBuilder.setDescription(annotation.description.data());
+		annotationBuilder.setFeature(annotation.feature.data());
+		annotationBuilder.setGeneticCode(annotation.geneticCode);
+	}
+}
+
+void AnnotationList::writeToProtocolBuffer(Harvest * harvest, const ReferenceList & referenceList) const
+{
+	int sequence = 0;
+	int offset = 0;
+	int offsetEnd = referenceList.getReference(0).sequence.length();
+	
+	for ( int i = 0; i < annotations.size(); i++ )
+	{
+		const Annotation & annotation = annotations.at(i);
+		
+		Harvest::AnnotationList::Annotation * msgAnn = harvest->mutable_annotations()->add_annotations();
+		
+		while ( annotation.start >= offsetEnd && sequence < referenceList.getReferenceCount() - 1 )
+		{
+			sequence++;
+			offset = offsetEnd;
+			offsetEnd += referenceList.getReference(sequence).sequence.length();
+		}
+		
+		msgAnn->set_sequence(sequence);
+	
+		for ( int j = 0; j < annotation.regionCount; j++ )
+		{
+			const AnnotationRegion & region = regions[annotation.regionFirst + j];
+			Harvest::AnnotationList::Annotation::Region * msgRegion = msgAnn->add_regions();
+			
+			msgRegion->set_start(region.start - offset);
+			msgRegion->set_end(region.end - offset);
 		}
 		
+		msgAnn->set_reverse(annotation.reverse);
+		msgAnn->set_name(annotation.name.data());
+		msgAnn->set_locus(annotation.locus.data());
+		msgAnn->set_description(annotation.description.data());
+		msgAnn->set_feature(annotation.feature.data());
+		
+		if ( annotation.geneticCode )
+		{
+			msgAnn->set_genetic_code(annotation.geneticCode);
+		}
+	}
+}
+
+void AnnotationList::index()
+{
+	int count = annotations.size();
+	
+	endsMax.resize(count);
+	
+	if ( count == 0 )
+	{
+		indexLevel = -1;
+		return;
+	}
+	
+	// Build up from the leaves, tracking the greatest end under the last
+	// node on each level, since nodes past the end have no entry of their
+	// own.
+	
+	int last;
+	int lastIndex;
+	
+	for ( int i = 0; i < count; i += 2 )
+	{
+		lastIndex = i;
+		last = endsMax[i] = annotations[i].end;
+	}
+	
+	int level;
+	
+	for ( level = 1; 1 << level <= count; level++ )
+	{
+		int offset = 1 << (level - 1);
+		
+		for ( int i = (offset << 1) - 1; i < count; i += offset << 2 )
+		{
+			int endLeft = endsMax[i - offset];
+			int endRight = i + offset < count ? endsMax[i + offset] : last;
+			
+			endsMax[i] = max(annotations[i].end, max(endLeft, endRight));
+		}
+		
+		lastIndex = lastIndex >> level & 1 ? lastIndex - offset : lastIndex + offset;
+		
+		if ( lastIndex < count && endsMax[lastIndex] > last )
+		{
+			last = endsMax[lastIndex];
+		}
+	}
+	
+	indexLevel = level - 1;
+}
+
+void AnnotationList::addFeature(GenbankFeature & feature, long int offset)
+{
+	for ( int i = 0; i < feature.regions.size(); i++ )
+	{
+		feature.regions[i].start += offset;
+		feature.regions[i].end += offset;
+	}
+	
+	annotations.resize(annotations.size() + 1);
+	
+	Annotation & annotation = annotations.back();
+	
+	setRegions(annotation, feature.regions);
+	annotation.reverse = feature.reverse;
+	annotation.name = addString(feature.name.data(), feature.name.length());
+	annotation.locus = addString(feature.locus.data(), feature.locus.length());
+	annotation.description = addString(feature.description.data(), feature.description.length());
+	annotation.feature = addString(feature.feature.data(), feature.feature.length());
+	annotation.geneticCode = feature.geneticCode;
+}
+
+string_view AnnotationList::addString(const char * string, size_t length)
+{
+	unordered_set<string_view>::const_iterator existing = strings.find(string_view(string, length));
+	
+	if ( existing != strings.end() )
+	{
+		return *existing;
+	}
+	
+	if ( stringBlocks.empty() || stringBlockUsed + length + 1 > stringBlockSize )
+	{
+		// strings too long for a block get one of their own
+		
+		stringBlocks.emplace_back(new char[max(stringBlockSize, length + 1)]);
+		stringBlockUsed = 0;
+	}
+	
+	char * copy = stringBlocks.back().get() + stringBlockUsed;
+	
+	memcpy(copy, string, length);
+	copy[length] = 0;
+	stringBlockUsed += length + 1;
+	
+	string_view view(copy, length);
+	
+	strings.insert(view);
+	return view;
+}
+
+void AnnotationList::parseGenbank(const char * file, bool useSeq, vector<GenbankRecord> & records)
+{
+	ifstream in(file);
+	char * line = new char[1 << 20];
+	char * state; // for strtok_r, since files are parsed concurrently
+	
+	while ( ! in.eof() )
+	{
+		records.resize(records.size() + 1);
+		
+		GenbankRecord & record = records.back();
+		GenbankFeature pending; // added when the next feature does not repeat its span
+		
+		record.version = false;
+		record.complete = false;
+		pending.valid = false;
+		
 		// header
 		
 		while ( in.getline(line, (1 << 20) - 1) )
@@ -102,7 +562,7 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 			
 			if ( useSeq && (token = removePrefix(line, "LOCUS")) )
 			{
-				locus = strtok(token, " \t");
+				record.locus = strtok_r(token, " \t", &state);
 			}
 			else if ( useSeq && (token = removePrefix(line, "DEFINITION")) )
 			{
@@ -113,12 +573,12 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 						token++;
 					}
 				
-					if ( definition.length() )
+					if ( record.definition.length() )
 					{
-						definition.append(" ");
+						record.definition.append(" ");
 					}
 				
-					definition.append(token);
+					record.definition.append(token);
 				
 					in.getline(token, (1 << 20) - 1);
 				}
@@ -131,21 +591,11 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 					token++;
 				}
 				
-				if ( *token )
-				{
-					char * acc = strtok(token, " \t\n");
-					int sequence = referenceList.getReferenceSequenceFromAcc(acc);
-					
-					offset = 0;
+				record.version = true;
 				
-					for ( int i = 0; i < sequence; i++ )
-					{
-						offset += referenceList.getReference(i).sequence.length();
-					}
-				}
-				else
+				if ( *token )
 				{
-					throw NoAccException(file);
+					record.accession = strtok_r(token, " \t\n", &state);
 				}
 			}
 			else if ( removePrefix(line, "FEATURES") )
@@ -166,7 +616,6 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 			}
 		
 			char * token = line;
-			char * suffix;
 		
 			while ( *token == ' ' )
 			{
@@ -175,93 +624,85 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 		
 			if ( token == line + 5 )
 			{
-				int start;
-				int end;
+				string feature = strtok_r(token, " ", &state);
+				string location = strtok_r(0, " ", &state);
+				vector<AnnotationRegion> regionsNew;
 				bool reverse;
-			
-				string feature = strtok(token, " ");
-			
-				token = strtok(0, " ");
-			
-				suffix = removePrefix(token, "complement(");
-				reverse = suffix;
-			
-				if ( suffix )
-				{
-					token = suffix;
-				}
-			
-				suffix = removePrefix(token, "join(");
-			
-				if ( suffix )
-				{
-					token = suffix;
-				}
-			
-				suffix = removePrefix(token, "order(");
-			
-				if ( suffix )
-				{
-					token = suffix;
-				}
-			
-				suffix = removePrefix(token, "complement(");
-			
-				if ( suffix )
+				
+				// locations of joins may continue on following lines
+				
+				while ( count(location.begin(), location.end(), '(') > count(location.begin(), location.end(), ')') && in.getline(line, (1 << 20) - 1) )
 				{
-					reverse = true;
-					token = suffix;
+					token = line;
+					
+					while ( *token == ' ' )
+					{
+						token++;
+					}
+					
+					location.append(token);
 				}
-			
-				if ( *token == '<' || *token == '>' )
+				
+				parseLocation(location, regionsNew, reverse);
+				
+				int start = regionsNew.size() ? min_element(regionsNew.begin(), regionsNew.end(), regionLessThan)->start : 0;
+				int end = start;
+				
+				for ( int i = 0; i < regionsNew.size(); i++ )
 				{
-					token++;
+					end = max(end, regionsNew[i].end);
 				}
-			
-				start = atoi(strtok(token, ".")) + offset - 1;
-				end = atoi(strtok(0, ".,)<>")) + offset - 1;
-			
-				if ( ! annotation || start != annotation->start || end != annotation->end || reverse != annotation->reverse )
+				
+				if ( ! pending.valid || start != pending.start || end != pending.end || reverse != pending.reverse )
 				{
-					if ( feature != "source" && feature != "misc_feature" )
+					if ( pending.valid )
 					{
-						annotations.resize(annotations.size() + 1);
-						annotation = &annotations.at(annotations.size() - 1);
+						record.features.push_back(pending);
+					}
 					
-						annotation->start = start;
-						annotation->end = end;
-						annotation->reverse = reverse;
+					if ( feature != "source" && feature != "misc_feature" && regionsNew.size() )
+					{
+						pending = GenbankFeature();
+						pending.valid = true;
+						pending.start = start;
+						pending.end = end;
+						pending.reverse = reverse;
 					}
 					else
 					{
-						annotation = 0;
+						pending.valid = false;
 					}
 				}
-			
-				if ( annotation )
+				
+				if ( pending.valid )
 				{
-					annotation->feature = feature;
+					pending.feature = feature;
+					pending.regions = regionsNew;
 				}
 			}
-			else if ( annotation )
+			else if ( pending.valid )
 			{
 				char * suffix;
 		
 				if ( (suffix = removePrefix(token, "/locus_tag=\"")) )
 				{
-					annotation->locus = strtok(suffix, "\"");
+					pending.locus = strtok_r(suffix, "\"", &state);
+				}
+				else if ( (suffix = removePrefix(token, "/gene=\"")) && pending.feature == "gene" )
+				{
+					pending.name = strtok_r(suffix, "\"", &state);
 				}
-				else if ( (suffix = removePrefix(token, "/gene=\"")) && annotation->feature == "gene" )
+				else if ( (suffix = removePrefix(token, "/transl_table=")) )
 				{
-					annotation->name = strtok(suffix, "\"");
+					pending.geneticCode = atoi(suffix);
 				}
 				else if ( (suffix = removePrefix(token, "/product=\"")) )
 				{
-					annotation->description = suffix;
+					pending.description = suffix;
 			
-					if ( annotation->description[annotation->description.length() - 1] == '"' )
+					if ( pending.description[pending.description.length() - 1] == '"' )
 					{
-						annotation->description.resize(annotation->description.length() - 1);
+						pending.description.resize(pending.description.length() - 1);
 					}
 				
 					while ( suffix[strlen(suffix) - 1] != '"' )
@@ -274,15 +715,22 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 							suffix++;
 						}
 					
-						annotation->description.append(suffix - 1, strlen(suffix));
+						pending.description.append(suffix - 1, strlen(suffix));
 					}
 				}
 			}
 		}
 	
+		if ( pending.valid )
+		{
+			record.features.push_back(pending);
+		}
+		
+		stable_sort(record.features.begin(), record.features.end(), [](const GenbankFeature & a, const GenbankFeature & b) { return a.start < b.start; });
+		
 		// sequence
 	
-		string sequence;
+		string & sequence = record.sequence;
 	
 		while ( ! in.eof() && strcmp(line, "//") != 0 )
 		{
@@ -295,10 +743,10 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 					break;
 				}
 		
-				strtok(line, " "); // eat number
+				strtok_r(line, " ", &state); // eat number
 				const char * token;
 		
-				while ( (token = strtok(0, " ")) )
+				while ( (token = strtok_r(0, " ", &state)) )
 				{
 					sequence.append(token);
 				}
@@ -310,143 +758,30 @@ void AnnotationList::initFromGenbank(const char * file, ReferenceList & referenc
 			break;
 		}
 		
-		if ( useSeq )
+		record.complete = true;
+		
+		for ( int i = 0; i < sequence.length(); i++ )
 		{
-			if ( sequence.length() )
-			{
-				for ( int i = 0; i < sequence.length(); i++ )
-				{
-					sequence[i] = toupper(sequence.at(i));
-				}
-			
-				referenceList.addReference(locus, definition, sequence);
-			}
-			else
-			{
-				clear();
-				throw NoSequenceException(file);
-			}
+			sequence[i] = toupper(sequence.at(i));
 		}
 	}
 	
-	sort(annotations.begin(), annotations.end(), annotationLessThan);
-	
-	for ( int i = 0; false && i < annotations.size(); i++ )
-	{
-		annotation = &annotations.at(i);
-		printf("%s\t%d\t%d\t%c\t%s\t%s\n", annotation->locus.c_str(), annotation->start, annotation->end, annotation->reverse ? '-' : '+', annotation->name.c_str(), annotation->description.c_str());
-	}
-	
 	delete [] line;
 	in.close();
 }
 
-void AnnotationList::initFromProtocolBuffer(const Harvest::AnnotationList & msg, const ReferenceList & referenceList)
-{
-	int sequence = 0;
-	int offset = 0;
-	
-	annotations.resize(0);
-	annotations.resize(msg.annotations_size());
-	
-	for ( int i = 0; i < msg.annotations_size(); i++ )
-	{
-		Annotation & annotation = annotations.at(i);
-		
-		const Harvest::AnnotationList::Annotation & msgAnn = msg.annotations(i);
-		
-		while ( sequence < msgAnn.sequence() && sequence < referenceList.getReferenceCount() )
-		{
-			offset += referenceList.getReference(sequence).sequence.length();
-			sequence++;
-		}
-		
-		if ( sequence == referenceList.getReferenceCount() )
-		{
-			offset = 0;
-			//printf("ERROR: sequence %d not found in reference or annotation out of order in protobuf.\n", msgAnn.sequence());
-			//exit(1);
-		}
-		
-		annotation.start = msgAnn.regions(0).start() + offset;
-		annotation.end = msgAnn.regions(0).end() + offset;
-		annotation.reverse = msgAnn.reverse();
-		annotation.name = msgAnn.name();
-		annotation.locus = msgAnn.locus();
-		annotation.description = msgAnn.description();
-		annotation.feature = msgAnn.feature();
-		
-		//printf("%s\t%d\t%d\t%d\t%c\t%s\t%s\n", annotation.locus.c_str(), msgAnn.sequence(), annotation.start, annotation.end, annotation.reverse ? '-' : '+', annotation.name.c_str(), annotation.description.c_str());
-	}
-}
-
-void AnnotationList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder, const ReferenceList & referenceList) const
+void AnnotationList::setRegions(Annotation & annotation, vector<AnnotationRegion> & regionsNew)
 {
-	int sequence = 0;
-	int offset = 0;
-	int offsetEnd = referenceList.getReference(0).sequence.length();
+	sort(regionsNew.begin(), regionsNew.end(), regionLessThan);
 	
-	auto annotationListBuilder = harvestBuilder.initAnnotationList();
-	auto annotationsBuilder = annotationListBuilder.initAnnotations(annotations.size());
-	
-	for ( int i = 0; i < annotations.size(); i++ )
-	{
-		const Annotation & annotation = annotations.at(i);
-		
-		auto annotationBuilder = annotationsBuilder[i];
-		
-		while ( annotation.start >= offsetEnd && sequence < referenceList.getReferenceCount() - 1 )
-		{
-			sequence++;
-			offset = offsetEnd;
-			offsetEnd += referenceList.getReference(sequence).sequence.length();
-		}
-		
-		annotationBuilder.setSequence(sequence);
-		
-		// TODO: multiple regions?
-		//
-		auto regionsBuilder = annotationBuilder.initRegions(1);
-		auto regionBuilder = regionsBuilder[0];
-		
-		regionBuilder.setStart(annotation.start - offset);
-		regionBuilder.setEnd(annotation.end - offset);
-		annotationBuilder.setReverse(annotation.reverse);
-		annotationBuilder.setName(annotation.name);
-		annotationBuilder.setLocus(annotation.locus);
-		annotationBuilder.setDescription(annotation.description);
-		annotationBuilder.setFeature(annotation.feature);
-	}
-}
-
-void AnnotationList::writeToProtocolBuffer(Harvest * harvest, const ReferenceList & referenceList) const
-{
-	int sequence = 0;
-	int offset = 0;
-	int offsetEnd = referenceList.getReference(0).sequence.length();
+	annotation.regionFirst = regions.size();
+	annotation.regionCount = regionsNew.size();
+	annotation.start = regionsNew.size() ? regionsNew[0].start : 0;
+	annotation.end = annotation.start;
 	
-	for ( int i = 0; i < annotations.size(); i++ )
+	for ( int i = 0; i < regionsNew.size(); i++ )
 	{
-		const Annotation & annotation = annotations.at(i);
-		
-		Harvest::AnnotationList::Annotation * msgAnn = harvest->mutable_annotations()->add_annotations();
-		
-		while ( annotation.start >= offsetEnd && sequence < referenceList.getReferenceCount() - 1 )
-		{
-			sequence++;
-			offset = offsetEnd;
-			offsetEnd += referenceList.getReference(sequence).sequence.length();
-		}
-		
-		msgAnn->set_sequence(sequence);
-	
-		msgAnn->add_regions();
-		msgAnn->mutable_regions(0)->set_start(annotation.start - offset);
-		msgAnn->mutable_regions(0)->set_end(annotation.end - offset);
-		msgAnn->set_reverse(annotation.reverse);
-		msgAnn->set_name(annotation.name);
-		msgAnn->set_locus(annotation.locus);
-		msgAnn->set_description(annotation.description);
-		msgAnn->set_feature(annotation.feature);
+		annotation.end = max(annotation.end, regionsNew[i].end);
+		regions.push_back(regionsNew[i]);
 	}
 }
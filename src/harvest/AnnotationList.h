@@ -7,7 +7,10 @@
 #ifndef AnnotationList_h
 #define AnnotationList_h
 
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 #include <map>
 #include <stdexcept>
@@ -16,15 +19,28 @@
 #include "harvest/pb/harvest.pb.h"
 #include "harvest/ReferenceList.h"
 
+struct AnnotationRegion
+{
+	int start;
+	int end;
+};
+
+// Text fields point into the list's string pool, and are null-terminated
+// there. Regions (e.g. the exons of a join) are a range of the list's region
+// array, sorted by start; start and end span all of them.
+//
 struct Annotation
 {
 	int start;
 	int end;
 	bool reverse;
-	std::string name;
-	std::string locus;
-	std::string description;
-	std::string feature;
+	int regionFirst;
+	int regionCount;
+	std::string_view name;
+	std::string_view locus;
+	std::string_view description;
+	std::string_view feature;
+	int geneticCode; // NCBI /transl_table id; 0 if not given (standard)
 };
 
 class AnnotationList
@@ -59,21 +75,82 @@ public:
 		std::string file;
 	};
 	
+	AnnotationList();
+	
 	void clear();
 	int getAnnotationCount() const;
 	const Annotation & getAnnotation(int index) const;
+	const AnnotationRegion & getRegion(int index) const; // see Annotation::regionFirst
+	void getAnnotationsOverlapping(int start, int end, std::vector<int> & indices) const; // inclusive concatenated coords; indices ascend
 	void initFromCapnp(const capnp::Harvest::Reader & harvestReader, const ReferenceList & referenceList);
 	void initFromGenbank(const char * file, ReferenceList & referenceList, bool useSeq);
+	void initFromGenbank(const std::vector<const char *> & files, ReferenceList & referenceList, bool useSeq, int threads = 1); // files are parsed concurrently
 	void initFromProtocolBuffer(const Harvest::AnnotationList & msg, const ReferenceList & referenceList);
 	void writeToCapnp(capnp::Harvest::Builder & harvestBuilder, const ReferenceList & referenceList) const;
 	void writeToProtocolBuffer(Harvest * msg, const ReferenceList & referenceList) const;
 	
 private:
 	
-	std::vector<Annotation> annotations;
+	// A GenBank feature being parsed, before its strings are pooled, in
+	// 0-based coordinates of its record
+	//
+	struct GenbankFeature
+	{
+		bool valid; // false if its qualifiers are being skipped
+		int start;
+		int end;
+		bool reverse;
+		std::vector<AnnotationRegion> regions;
+		std::string name;
+		std::string locus;
+		std::string description;
+		std::string feature;
+		int geneticCode;
+	};
+	
+	// A parsed GenBank record, not yet placed on a reference
+	//
+	struct GenbankRecord
+	{
+		std::string locus;
+		std::string definition;
+		std::string accession;
+		std::string sequence; // only if reading sequence
+		bool version; // false if there was no VERSION line
+		bool complete; // false if the file ended before "//"
+		std::vector<GenbankFeature> features; // sorted by start
+	};
+	
+	AnnotationList(const AnnotationList &);
+	AnnotationList & operator=(const AnnotationList &);
+	
+	void addFeature(GenbankFeature & feature, long int offset);
+	std::string_view addString(const char * string, size_t length); // pooled, null-terminated
+	void index();
+	static void parseGenbank(const char * file, bool useSeq, std::vector<GenbankRecord> & records); // uses no shared state
+	void setRegions(Annotation & annotation, std::vector<AnnotationRegion> & regionsNew); // sorts and appends them
+	
+	std::vector<Annotation> annotations; // sorted by start
+	std::vector<AnnotationRegion> regions;
+	
+	// Distinct strings are stored once each, in large blocks that are never
+	// moved, so views of them stay valid as the pool grows.
+	//
+	std::vector<std::unique_ptr<char[]> > stringBlocks;
+	size_t stringBlockUsed;
+	std::unordered_set<std::string_view> strings;
+	
+	// Implicit interval tree over the annotations: in-order positions of a
+	// complete binary tree are the array indices, so leaves are the even
+	// indices and a node at level k is at an index with its k lowest bits set.
+	// Each node stores the greatest end in its subtree.
+	//
+	std::vector<int> endsMax;
+	int indexLevel; // of the root; -1 if empty
 };
 
 inline int AnnotationList::getAnnotationCount() const { return annotations.size(); }
 inline const Annotation & AnnotationList::getAnnotation(int index) const { return annotations.at(index); }
+inline const AnnotationRegion & AnnotationList::getRegion(int index) const { return regions.at(index); }
 
 #endif
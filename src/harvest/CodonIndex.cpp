@@ -0,0 +1,175 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/CodonIndex.h"
+#include "harvest/codon.h"
+
+using namespace::std;
+
+static const int codonFlagShift = 6; // flags for bases that aren't nucleotides
+
+CodonIndex::CodonIndex()
+{
+	annotationList = 0;
+	codonStarts.push_back(0);
+}
+
+void CodonIndex::clear()
+{
+	annotationList = 0;
+	codonStarts.assign(1, 0);
+	codons.clear();
+	regionOffsets.clear();
+}
+
+bool CodonIndex::getCodon(int annotation, long int position, unsigned short & codon, int & frame) const
+{
+	if ( annotation + 1 >= codonStarts.size() || codonStarts[annotation] == codonStarts[annotation + 1] )
+	{
+		return false;
+	}
+	
+	const Annotation & cds = annotationList->getAnnotation(annotation);
+	
+	if ( position < cds.start || position > cds.end )
+	{
+		return false;
+	}
+	
+	// last region starting at or before the position
+	
+	int low = cds.regionFirst;
+	int high = cds.regionFirst + cds.regionCount;
+	
+	while ( high - low > 1 )
+	{
+		int middle = (low + high) / 2;
+		
+		if ( annotationList->getRegion(middle).start <= position )
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	
+	const AnnotationRegion & region = annotationList->getRegion(low);
+	
+	if ( position > region.end )
+	{
+		return false; // intron
+	}
+	
+	long int offset = regionOffsets[low] + (cds.reverse ? region.end - position : position - region.start);
+	
+	codon = codons[codonStarts[annotation] + offset / 3];
+	frame = offset % 3;
+	
+	return true;
+}
+
+void CodonIndex::init(const AnnotationList & annotationListNew, const ReferenceList & referenceList)
+{
+	clear();
+	annotationList = &annotationListNew;
+	codonStarts.resize(annotationList->getAnnotationCount() + 1);
+	
+	vector<long int> positions; // coding sequence of a CDS, in concatenated coords
+	
+	for ( int i = 0; i < annotationList->getAnnotationCount(); i++ )
+	{
+		const Annotation & cds = annotationList->getAnnotation(i);
+		
+		codonStarts[i + 1] = codonStarts[i];
+		
+		if ( cds.feature != "CDS" || cds.regionCount == 0 || cds.end < cds.start )
+		{
+			continue;
+		}
+		
+		if ( regionOffsets.size() < cds.regionFirst + cds.regionCount )
+		{
+			regionOffsets.resize(cds.regionFirst + cds.regionCount);
+		}
+		
+		// regions in coding order
+		
+		positions.clear();
+		
+		for ( int j = 0; j < cds.regionCount; j++ )
+		{
+			int index = cds.reverse ? cds.regionFirst + cds.regionCount - 1 - j : cds.regionFirst + j;
+			const AnnotationRegion & region = annotationList->getRegion(index);
+			
+			regionOffsets[index] = positions.size();
+			
+			for ( long int k = 0; k <= region.end - region.start; k++ )
+			{
+				positions.push_back(cds.reverse ? region.end - k : region.start + k);
+			}
+		}
+		
+		// complete a partial last codon past the CDS
+		
+		while ( positions.size() % 3 )
+		{
+			positions.push_back(positions.back() + (cds.reverse ? -1 : 1));
+		}
+		
+		// bases are read from the reference the CDS starts in (none if it is
+		// not a reference, leaving every codon flagged)
+		
+		int sequence = referenceList.getReferenceSequenceFromConcatenated(cds.start);
+		const string * refseq = sequence == undef ? 0 : &referenceList.getReference(sequence).sequence;
+		long int offset = sequence == undef ? 0 : referenceList.getConcatenatedPosition(sequence, 0);
+		
+		for ( long int j = 0; j < positions.size(); j += 3 )
+		{
+			unsigned short codon = 0;
+			
+			for ( int k = 0; k < 3; k++ )
+			{
+				long int position = positions[j + k] - offset;
+				int base = refseq && position >= 0 && position < refseq->length() ? getBaseCode((*refseq)[position]) : codonUndef;
+				
+				if ( base == codonUndef )
+				{
+					codon |= 1 << (codonFlagShift + k);
+				}
+				else
+				{
+					codon |= (cds.reverse ? base ^ 2 : base) << 2 * (2 - k);
+				}
+			}
+			
+			codons.push_back(codon);
+		}
+		
+		codonStarts[i + 1] = codons.size();
+	}
+}
+
+unsigned short CodonIndex::getCodonAlt(unsigned short codon, int frame, char allele, bool reverse)
+{
+	int base = getBaseCode(allele);
+	int shift = 2 * (2 - frame);
+	
+	codon &= ~(3 << shift | 1 << (codonFlagShift + frame));
+	
+	if ( base == codonUndef )
+	{
+		return codon | 1 << (codonFlagShift + frame);
+	}
+	
+	return codon | (reverse ? base ^ 2 : base) << shift;
+}
+
+char CodonIndex::translate(unsigned short codon, int geneticCode)
+{
+	return codon >> codonFlagShift ? '.' : translateCodon(codon, false, geneticCode);
+}
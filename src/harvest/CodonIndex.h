@@ -0,0 +1,44 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef CodonIndex_h
+#define CodonIndex_h
+
+#include <vector>
+#include "harvest/AnnotationList.h"
+#include "harvest/ReferenceList.h"
+
+// Reference codons of every CDS, read in coding order (complemented on the
+// reverse strand), so a variant's codon and frame are found by arithmetic on
+// its position instead of by reading and translating reference text. Each
+// codon is packed into 16 bits: the 6-bit codon code of codon.h, plus a flag
+// for each of the three bases that is not an uppercase nucleotide. Codons
+// are read in frame from the start of coding sequence, across the regions of
+// a join; a partial last codon is completed from the reference past the CDS,
+// as far as it goes.
+//
+class CodonIndex
+{
+public:
+	
+	CodonIndex();
+	
+	void clear();
+	bool getCodon(int annotation, long int position, unsigned short & codon, int & frame) const; // false if not a CDS or not in its coding sequence (e.g. in an intron)
+	void init(const AnnotationList & annotationList, const ReferenceList & referenceList);
+	
+	static unsigned short getCodonAlt(unsigned short codon, int frame, char allele, bool reverse); // allele on the forward strand
+	static char translate(unsigned short codon, int geneticCode);
+	
+private:
+	
+	const AnnotationList * annotationList;
+	std::vector<int> codonStarts; // by annotation, plus the total
+	std::vector<unsigned short> codons;
+	std::vector<long int> regionOffsets; // coding offset of each CDS region, by region index
+};
+
+#endif
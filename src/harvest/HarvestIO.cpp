@@ -11,10 +11,14 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <capnp/message.h>
 #include <capnp/serialize.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include "MappedFile.h"
+#include "OutputSink.h"
 #include "parse.h"
+#include "zblock.h"
 #include <sys/stat.h>
 #include <string.h>
 #include <unistd.h>
@@ -33,6 +37,7 @@ using namespace::google::protobuf::io;
 HarvestIO::HarvestIO()
 {
 	GOOGLE_PROTOBUF_VERIFY_VERSION;
+	threads = 1;
 }
 
 void HarvestIO::clear()
@@ -60,8 +65,18 @@ void HarvestIO::loadGenbank(const char * file, bool useSeq)
 	annotationList.initFromGenbank(file, referenceList, useSeq);
 }
 
-bool HarvestIO::loadHarvest(const char * file)
+void HarvestIO::loadGenbank(const vector<const char *> & files, bool useSeq)
 {
+	annotationList.initFromGenbank(files, referenceList, useSeq, threads);
+}
+
+bool HarvestIO::loadHarvest(const char * file, int sections)
+{
+	if ( sections & SECTION_annotations )
+	{
+		sections |= SECTION_references; // annotations are placed on references
+	}
+	
 	ifstream in(file);
 	
 	char header[capnpHeaderLength];
@@ -71,129 +86,97 @@ bool HarvestIO::loadHarvest(const char * file)
 	
 	if ( false || strncmp(header, capnpHeader, capnpHeaderLength) == 0 )
 	{
-		return loadHarvestCapnp(file);
+		return loadHarvestCapnp(file, sections);
 	}
 	else
 	{
-		return loadHarvestProtocolBuffer(file);
+		return loadHarvestProtocolBuffer(file, sections);
 	}
 }
 
-bool HarvestIO::loadHarvestCapnp(const char * file)
+bool HarvestIO::loadHarvestCapnp(const char * file, int sections)
 {
-	// use a pipe to decompress input to Cap'n Proto
+	MappedFile mappedFile;
 	
-	int fds[2];
-	int piped = pipe(fds);
-	
-	if ( piped < 0 )
+	if ( ! mappedFile.open(file) || mappedFile.getSize() < capnpHeaderLength )
 	{
-		cerr << "ERROR: could not open pipe for decompression\n";
-		return 1;
+		cerr << "ERROR: could not open " << file << " for reading.\n";
+		return false;
 	}
 	
-	int forked = fork();
+	const unsigned char * data = mappedFile.getData() + capnpHeaderLength;
+	size_t size = mappedFile.getSize() - capnpHeaderLength;
+	kj::ArrayPtr<const capnp::word> array;
+	vector<uint64_t> words;
 	
-	if ( forked < 0 )
+	if ( size >= 1 + capnpFlatTagLength && data[0] == 0 && memcmp(data + 1, capnpFlatTag, capnpFlatTagLength) == 0 )
 	{
-		cerr << "ERROR: could not fork for decompression\n";
-		return 1;
+		// uncompressed; read the message in place from the mapping
+		
+		array = kj::ArrayPtr<const capnp::word>(reinterpret_cast<const capnp::word *>(data + 1 + capnpFlatTagLength), (size - 1 - capnpFlatTagLength) / sizeof(capnp::word));
 	}
-	
-	if ( forked == 0 )
+	else
 	{
-		// read from zipped fd and write to pipe
-		
-		close(fds[0]); // other process's end of pipe
+		// decompress in-process into an aligned buffer for Cap'n Proto
 		
-		int fd = open(file, O_RDONLY);
+		int ret = inflateBlocks(data, size, words, threads);
 		
-		if ( fd < 0 )
+		if ( ret != Z_OK )
 		{
-			cerr << "ERROR: could not open " << file << " for reading.\n";
-			exit(1);
+			zerr(ret);
+			return false;
 		}
 		
-		char buffer[1024];
-		
-		read(fd, buffer, capnpHeaderLength);
-		
-		int ret = inf(fd, fds[1]);
-		if (ret != Z_OK) zerr(ret);
-		close(fd);
-		exit(ret);
-		
-		gzFile fileIn = gzopen(file, "rb");
-		
-		int bytesRead;
-		
-		// eat header
-		//
-		//gzseek(fileIn, capnpHeaderLength, SEEK_SET);
-		gzread(fileIn, buffer, capnpHeaderLength);
-		
-		printf("header: %s\n", buffer);
-		while ( (bytesRead = gzread(fileIn, buffer, sizeof(buffer))) > 0)
-		{
-			printf("uncompressed: %s\n", buffer);
-			write(fds[1], buffer, bytesRead);
-		}
-		
-		gzclose(fileIn);
-		close(fds[1]);
-		exit(0);
+		mappedFile.close();
+		array = kj::ArrayPtr<const capnp::word>(reinterpret_cast<const capnp::word *>(words.data()), words.size());
 	}
 	
-	// read from pipe
-	
-	close(fds[1]); // other process's end of pipe
-	
 	capnp::ReaderOptions readerOptions;
 	
 	readerOptions.traversalLimitInWords = 1000000000000;
 	readerOptions.nestingLimit = 1000000;
 	
-	//char buffer[1024];
-	//read(fds[0], buffer, 1024);
-	//printf("data: %s\n", buffer);
-	//return true;
-	
-	capnp::StreamFdMessageReader message(fds[0], readerOptions);
+	capnp::FlatArrayMessageReader message(array, readerOptions);
 	
 	capnp::Harvest::Reader harvestReader = message.getRoot<capnp::Harvest>();
 	
-	if ( harvestReader.hasReferenceList() )
+	// Cap'n Proto decodes lazily, so sections that are skipped here are never
+	// touched (or, for uncompressed files, even paged in)
+	
+	if ( harvestReader.hasReferenceList() && sections & SECTION_references )
 	{
 		referenceList.initFromCapnp(harvestReader);
 	}
 	
-	if ( harvestReader.hasAnnotationList() )
+	if ( harvestReader.hasAnnotationList() && sections & SECTION_annotations )
 	{
 		annotationList.initFromCapnp(harvestReader, referenceList);
 	}
 	
-	trackList.initFromCapnp(harvestReader);
+	if ( sections & SECTION_tracks )
+	{
+		trackList.initFromCapnp(harvestReader);
+	}
 	
-	if ( harvestReader.hasTree() )
+	if ( harvestReader.hasTree() && sections & SECTION_tree )
 	{
 		phylogenyTree.initFromCapnp(harvestReader);
 	}
 	
-	if ( harvestReader.hasLcbList() )
+	if ( harvestReader.hasLcbList() && sections & SECTION_lcbs )
 	{
 		lcbList.initFromCapnp(harvestReader);
 	}
 	
-	if ( harvestReader.hasVariantList() )
+	if ( harvestReader.hasVariantList() && sections & SECTION_variants )
 	{
 		variantList.initFromCapnp(harvestReader);
 	}
 	
-	close(fds[0]);
 	return true;
 }
 
-bool HarvestIO::loadHarvestProtocolBuffer(const char * file)
+bool HarvestIO::loadHarvestProtocolBuffer(const char * file, int sections)
 {
 	Harvest harvest;
 	
@@ -222,29 +205,32 @@ bool HarvestIO::loadHarvestProtocolBuffer(const char * file)
 		return false;
 	}
 	
-	if ( harvest.has_reference() )
+	if ( harvest.has_reference() && sections & SECTION_references )
 	{
 		referenceList.initFromProtocolBuffer(harvest.reference());
 	}
 	
-	if ( harvest.has_annotations() )
+	if ( harvest.has_annotations() && sections & SECTION_annotations )
 	{
 		annotationList.initFromProtocolBuffer(harvest.annotations(), referenceList);
 	}
 	
-	trackList.initFromProtocolBuffer(harvest.tracks());
+	if ( sections & SECTION_tracks )
+	{
+		trackList.initFromProtocolBuffer(harvest.tracks());
+	}
 	
-	if ( harvest.has_tree() )
+	if ( harvest.has_tree() && sections & SECTION_tree )
 	{
 		phylogenyTree.initFromProtocolBuffer(harvest.tree());
 	}
 	
-	if ( harvest.has_alignment() )
+	if ( harvest.has_alignment() && sections & SECTION_lcbs )
 	{
 		lcbList.initFromProtocolBuffer(harvest.alignment());
 	}
 	
-	if ( harvest.has_variation() )
+	if ( harvest.has_variation() && sections & SECTION_variants )
 	{
 		variantList.initFromProtocolBuffer(harvest.variation());
 	}
@@ -258,7 +244,7 @@ bool HarvestIO::loadHarvestProtocolBuffer(const char * file)
 
 void HarvestIO::loadMaf(const char * file, bool findVariants, const char * referenceFileName)
 {
-	lcbList.initFromMaf(file, &referenceList, &trackList, &phylogenyTree, findVariants ? &variantList : 0, referenceFileName);
+	lcbList.initFromMaf(file, &referenceList, &trackList, &phylogenyTree, findVariants ? &variantList : 0, referenceFileName, threads);
 }
 
 void HarvestIO::loadMfa(const char * file, bool findVariants)
@@ -283,7 +269,7 @@ void HarvestIO::loadVcf(const char * file)
 
 void HarvestIO::loadXmfa(const char * file, bool findVariants)
 {
-	lcbList.initFromXmfa(file, &referenceList, &trackList, &phylogenyTree, findVariants ? &variantList : 0);
+	lcbList.initFromXmfa(file, &referenceList, &trackList, &phylogenyTree, findVariants ? &variantList : 0, threads);
 }
 
 void HarvestIO::writeFasta(std::ostream &out) const
@@ -291,75 +277,8 @@ void HarvestIO::writeFasta(std::ostream &out) const
 	referenceList.writeToFasta(out);
 }
 
-void HarvestIO::writeHarvest(const char * file)
+void HarvestIO::writeHarvest(const char * file, bool compress) const
 {
-	// use a pipe to compress Cap'n Proto output
-	
-	int fds[2];
-	int piped = pipe(fds);
-	
-	if ( piped < 0 )
-	{
-		cerr << "ERROR: could not open pipe for compression\n";
-		exit(1);
-	}
-	
-	int forked = fork();
-	
-	if ( forked < 0 )
-	{
-		cerr << "ERROR: could not fork for compression\n";
-		exit(1);
-	}
-	
-	if ( forked == 0 )
-	{
-		// read from pipe and write to compressed file
-		
-		close(fds[1]); // other process's end of pipe
-		
-		int fd = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0644);
-		
-		if ( fd < 0 )
-		{
-			cerr << "ERROR: could not open " << file << " for writing.\n";
-			exit(1);
-		}
-		
-		// write header
-		//
-		write(fd, capnpHeader, capnpHeaderLength);
-		//close(fd);
-		
-		int ret = def(fds[0], fd, Z_DEFAULT_COMPRESSION);
-		if (ret != Z_OK) zerr(ret);
-        exit(ret);
-        
-		char buffer[1024];
-		gzFile fileOut = gzopen(file, "ab");
-		
-		int bytesRead;
-		
-		while ( (bytesRead = read(fds[0], buffer, sizeof(buffer))) > 0)
-		{
-			printf("compressing: %s\n", buffer);
-			gzwrite(fileOut, buffer, bytesRead);
-		}
-		
-		gzclose(fileOut);
-		close(fds[0]);
-		exit(0);
-	}
-	
-	// write to pipe
-	
-	close(fds[0]); // other process's end of pipe
-	/*
-	write(fds[1], "test\n", 5);
-	close(fds[1]);
-	return;
-	*/
-	
 	capnp::MallocMessageBuilder message;
 	capnp::Harvest::Builder harvestBuilder = message.initRoot<capnp::Harvest>();
 	
@@ -390,25 +309,93 @@ void HarvestIO::writeHarvest(const char * file)
 		variantList.writeToCapnp(harvestBuilder);
 	}
 	
-	//write(fds[1], capnpHeader, capnpHeaderLength);
+	// compress the segments in place (rather than copying the message to a
+	// flat array first), preceded by the standard segment table: segment
+	// count minus one and the size of each segment in words, padded to a
+	// whole word
+	
+	kj::ArrayPtr<const kj::ArrayPtr<const capnp::word> > segments = message.getSegmentsForOutput();
+	vector<uint32_t> segmentTable((segments.size() + 2) & ~1, 0);
+	vector<pair<const unsigned char *, size_t> > pieces;
+	
+	segmentTable[0] = segments.size() - 1;
+	
+	for ( int i = 0; i < segments.size(); i++ )
+	{
+		segmentTable[i + 1] = segments[i].size();
+	}
+	
+	pieces.push_back(make_pair((const unsigned char *)segmentTable.data(), segmentTable.size() * sizeof(uint32_t)));
+	
+	for ( int i = 0; i < segments.size(); i++ )
+	{
+		pieces.push_back(make_pair((const unsigned char *)segments[i].begin(), segments[i].size() * sizeof(capnp::word)));
+	}
+	
+	int fd = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	
+	if ( fd < 0 )
+	{
+		cerr << "ERROR: could not open " << file << " for writing.\n";
+		exit(1);
+	}
 	
-	//write(fds[1], "hello", 5);
-	writeMessageToFd(fds[1], message);
+	struct stat st;
+	bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode); // (not e.g. /dev/stdout)
 	
-//	FileOutputStream stream(fd);
-//	GzipOutputStream zip_stream(&stream);
+	// write header
+	//
+	int ret = write(fd, capnpHeader, capnpHeaderLength) == capnpHeaderLength ? Z_OK : Z_ERRNO;
+	int error = errno; // of the failing write, before close() can change it
 	
-//	if ( ! harvest.SerializeToZeroCopyStream(&zip_stream) )
-//	{
-//		printf("Failed to write.\n");
-//	}
+	if ( ret == Z_OK && compress )
+	{
+		ret = deflateBlocks(pieces, fd, Z_DEFAULT_COMPRESSION, threads);
+		error = errno;
+	}
+	else if ( ret == Z_OK )
+	{
+		// uncompressed, padded so the message is word-aligned
+		
+		pieces.insert(pieces.begin(), make_pair((const unsigned char *)capnpFlatTag, (size_t)capnpFlatTagLength));
+		pieces.insert(pieces.begin(), make_pair((const unsigned char *)"", (size_t)1));
+		
+		for ( int i = 0; i < pieces.size() && ret == Z_OK; i++ )
+		{
+			if ( ! writeAll(fd, pieces[i].first, pieces[i].second) )
+			{
+				ret = Z_ERRNO;
+				error = errno;
+			}
+		}
+	}
 	
-//	zip_stream.Close();
-//	stream.Close();
-	close(fds[1]);
+	if ( close(fd) < 0 && ret == Z_OK )
+	{
+		ret = Z_ERRNO;
+		error = errno;
+	}
 	
-//	harvest.Clear();
-//	google::protobuf::ShutdownProtobufLibrary();
+	if ( ret != Z_OK )
+	{
+		// don't leave a truncated file behind
+		
+		if ( regular )
+		{
+			unlink(file);
+		}
+		
+		if ( ret == Z_ERRNO )
+		{
+			cerr << "ERROR: could not write " << file << " (" << strerror(error) << ").\n";
+		}
+		else
+		{
+			zerr(ret);
+		}
+		
+		exit(1);
+	}
 }
 
 void HarvestIO::writeMfa(std::ostream &out) const
@@ -437,8 +424,10 @@ void HarvestIO::writeXmfa(std::ostream &out, bool split) const
 	lcbList.writeToXmfa(out, referenceList, trackList, variantList);
 }
 
-void HarvestIO::writeBackbone(std::ostream &out) const
+void HarvestIO::writeBackbone(std::ostream &stream) const
 {
+	OutputSink out(stream);
+	
 	int i = 0;
 	
 	for ( i = 0; i < trackList.getTrackCount(); i++ )
@@ -449,7 +438,7 @@ void HarvestIO::writeBackbone(std::ostream &out) const
 		
 		if ( i == trackList.getTrackCount() - 1 )
 		{
-			out << endl;
+			out << '\n';
 		}
 		else
 		{
@@ -479,7 +468,7 @@ void HarvestIO::writeBackbone(std::ostream &out) const
 		  
 		  if ( r == lcb.regions.size() - 1 )
 		  {
-		  	out << endl;
+		  	out << '\n';
 		  }
 		  else
 		  {
@@ -527,7 +516,7 @@ void HarvestIO::writeVcf(std::ostream &out, const vector<string> * trackNames, c
 		}
 	}
 	
-	variantList.writeToVcf(out, indels, referenceList, annotationList, trackList, tracks, signature);
+	variantList.writeToVcf(out, indels, referenceList, annotationList, trackList, tracks, signature, threads);
 }
 
 
@@ -21,10 +21,31 @@
 static const char * capnpHeader = "Cap'n Proto";
 static const int capnpHeaderLength = strlen(capnpHeader);
 
+// Uncompressed Cap'n Proto Harvest files follow the header with a null byte
+// and this tag, which pads the header to a whole number of words so the
+// message can be read in place from a memory-mapped file.
+//
+static const char * capnpFlatTag = "flat";
+static const int capnpFlatTagLength = strlen(capnpFlatTag);
+static const int capnpFlatHeaderLength = capnpHeaderLength + 1 + capnpFlatTagLength;
+
 class HarvestIO
 {
 public:
 
+	// Sections of a Harvest file, for loading only what is needed
+	//
+	enum Section
+	{
+		SECTION_references = 1,
+		SECTION_annotations = 2,
+		SECTION_tracks = 4,
+		SECTION_tree = 8,
+		SECTION_lcbs = 16,
+		SECTION_variants = 32,
+		SECTION_all = 63,
+	};
+	
 	HarvestIO();
 	
 	void clear();
@@ -32,9 +53,10 @@ public:
 	void loadBed(const char * file, const char * name, const char * desc);
 	void loadFasta(const char * file);
 	void loadGenbank(const char * file, bool useSeq);
-	bool loadHarvest(const char * file);
-	bool loadHarvestCapnp(const char * file);
-	bool loadHarvestProtocolBuffer(const char * file);
+	void loadGenbank(const std::vector<const char *> & files, bool useSeq); // parsed with the set number of threads
+	bool loadHarvest(const char * file, int sections = SECTION_all);
+	bool loadHarvestCapnp(const char * file, int sections = SECTION_all);
+	bool loadHarvestProtocolBuffer(const char * file, int sections = SECTION_all);
 	void loadMaf(const char * file, bool findVariants, const char * referenceFileName);
 	void loadMfa(const char * file, bool findVariants);
 	void loadNewick(const char * file);
@@ -42,7 +64,7 @@ public:
 	void loadXmfa(const char * file, bool findVariants);
 	
 	void writeFasta(std::ostream &out) const;
-	void writeHarvest(const char * file);
+	void writeHarvest(const char * file, bool compress = true) const;
 	void writeMfa(std::ostream &out) const;
 	void writeFilteredMfa(std::ostream &out, std::ostream &out2) const;
 	void writeNewick(std::ostream &out, bool useMult = false) const;
@@ -51,6 +73,9 @@ public:
 	void writeXmfa(std::ostream &out, bool split = false) const;
 	void writeBackbone(std::ostream &out) const;
 	
+	int getThreads() const;
+	void setThreads(int threadsNew);
+	
 	ReferenceList referenceList;
 	AnnotationList annotationList;
 	PhylogenyTree phylogenyTree;
@@ -61,8 +86,13 @@ public:
 private:
 	
 	void writeNewickNode(std::ostream &out, const Harvest::Tree::Node & msg) const;
+	
+	int threads;
 };
 
+inline int HarvestIO::getThreads() const { return threads; }
+inline void HarvestIO::setThreads(int threadsNew) { threads = threadsNew; }
+
 int def(int fdSource, int fdDest, int level);
 int inf(int fdSource, int fdDest);
 void zerr(int ret);
@@ -8,13 +8,21 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include "harvest/MappedFile.h"
+#include "harvest/OutputSink.h"
 #include "harvest/parse.h"
 #include <set>
 #include <stdlib.h>
+#include <string.h>
 #include "harvest/exceptions.h"
+#include "harvest/ThreadPool.h"
+#include "harvest/VariantCaller.h"
 #include "harvest/VariantList.h"
 #include <algorithm>
 #include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace::std;
 
@@ -130,12 +138,10 @@ void LcbList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
 	}
 }
 
-void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, const char * referenceFileName)
+void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, const char * referenceFileName, int threads)
 {
 	lcbs.resize(0);
 	
-	ifstream in(file);
-	string line;
 	int trackCount = 0;
 	vector<string> seqs;
 	const bool oldTags = phylogenyTree->getRoot();
@@ -143,8 +149,9 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 	bool mauve = false;
 	vector<string> refs;
 	vector<string> refNames;
-	map<string, int> refIndexByName;
-	vector<map<string, int> > regionOffsetBySeqNameByTrack;
+	unordered_map<string, int> refIndexByName;
+	unordered_map<string, int> trackIndexByName;
+	vector<unordered_map<string, int> > regionOffsetBySeqNameByTrack;
 	vector<int> totalOffsetByTrack;
 	
 	set<Interval> lcbIntervals;
@@ -156,6 +163,11 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 		variantList->init();
 	}
 	
+	// variants are called on the pool while parsing continues
+	//
+	ThreadPool threadPool(variantList ? threads : 1);
+	VariantCaller variantCaller(variantList, referenceList, &threadPool);
+	
 	if ( oldTags )
 	{
 		trackIndecesNew = new int[trackList->getTrackCount()];
@@ -210,36 +222,36 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 	LcbList::Lcb * lcb = 0;
 	bool lcbReverse;
 	
-	TrackList::Track * track;
-	char * suffix;
 	int queryCount = 0;
 	int lcbQueryCount = 0;
 	vector<int> queryCountsByLcb;
-	set<string> seqNames;
+	unordered_set<string_view> seqNames; // views into the mapping
 	
 	// scan through once to determine number of query sequences...
 	
-	if ( ! in.is_open() )
+	MappedFile mappedFile;
+	
+	if ( ! mappedFile.open(file) )
 	{
 		cerr << "ERROR: " << file << " could not be opened.";
 		return;
 	}
 	
-	while ( getline(in, line) )
+	const char * dataStart = (const char *)mappedFile.getData();
+	const char * dataEnd = dataStart + mappedFile.getSize();
+	const char * data = dataStart;
+	string_view line;
+	
+	while ( nextLine(data, dataEnd, line) )
 	{
-		if ( line[0] == 's' )
+		if ( line.size() && line[0] == 's' )
 		{
-			stringstream lineStream(line);
-			
-			lineStream.ignore(2);
-			
-			string trackName;
-			getline(lineStream, trackName, '.');
-			seqNames.insert(trackName);
+			string_view fields = line.substr(min(line.size(), (size_t)2));
 			
+			seqNames.insert(splitPrefix(fields, '.'));
 			lcbQueryCount++;
 		}
-		else if ( line[0] == 0 )
+		else if ( line.empty() )
 		{
 			queryCountsByLcb.push_back(lcbQueryCount);
 			lcbQueryCount = 0;
@@ -252,17 +264,24 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 	
 	// ...now parse only those that are core
 	
-	in.clear();
-	in.seekg(0);
+	data = dataStart;
 	int lcbIndex = 0;
+	bool skip = false; // eating the rest of a block
+	string key; // reused for hashed name lookups
 	
-	while ( getline(in, line) )
+	while ( nextLine(data, dataEnd, line) )
 	{
-		if ( line[0] == 'a' )
+		if ( skip )
+		{
+			skip = ! line.empty();
+			continue;
+		}
+		
+		if ( line.size() && line[0] == 'a' )
 		{
 			// new alignment block; first check if it's core
 			
-			if ( queryCountsByLcb[lcbIndex] == queryCount )
+			if ( lcbIndex < queryCountsByLcb.size() && queryCountsByLcb[lcbIndex] == queryCount )
 			{
 				// core; create a new Lcb
 				
@@ -278,45 +297,51 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 			{
 				// not core; eat it
 				
-				while ( in.peek() != '\n' )
-				{
-					in.ignore(numeric_limits<streamsize>::max(), '\n');
-				}
-				
+				skip = true;
 				lcb = 0;
 			}
 			
 			lcbIndex++;
 		}
-		else if ( line[0] == 's' )
+		else if ( line.size() && line[0] == 's' )
 		{
-			stringstream lineStream(line);
-			
-			lineStream.ignore(2);
-			
-			string trackName;
-			getline(lineStream, trackName, '.');
+			string_view fields = line.substr(min(line.size(), (size_t)2));
+			string_view trackName = splitPrefix(fields, '.');
 			
 			int trackIndex;
 			
-			// create track if name is new
+			key.assign(trackName);
+			
+			unordered_map<string, int>::iterator trackFound = trackIndexByName.find(key);
 			
-			try
+			if ( trackFound != trackIndexByName.end() )
 			{
-				trackIndex = trackList->getTrackIndexByFile(trackName);
+				trackIndex = trackFound->second;
 			}
-			catch ( const TrackList::TrackNotFoundException & e )
+			else
 			{
-				if ( oldTags )
+				// create track if name is new
+				
+				try
 				{
-					delete [] trackIndecesNew;
-					throw;
-					return;
+					trackIndex = trackList->getTrackIndexByFile(key);
 				}
-				else
+				catch ( const TrackList::TrackNotFoundException & e )
 				{
-					trackIndex = trackList->addTrack(trackName);
+					if ( oldTags )
+					{
+						delete [] trackIndecesNew;
+						throw;
+						return;
+					}
+					else
+					{
+						trackIndex = trackList->addTrack(key);
+					}
 				}
+				
+				trackList->getTrackMutable(trackIndex).file = key;
+				trackIndexByName[key] = trackIndex;
 			}
 			
 			if ( oldTags && trackCount < trackList->getTrackCount() )
@@ -325,26 +350,9 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 				trackCount++;
 			}
 			
-			track = &trackList->getTrackMutable(trackIndex);
-			
-			// basename parsing; not sure if this is needed for MAF
-			//
-/*					char * name = suffix;
-			
-			for ( int i = 0; i < strlen(suffix) - 1; i++ )
-			{
-				if ( suffix[i] == '/' )
-				{
-					name = suffix + i + 1;
-				}
-			}
-*/					
-			track->file = trackName;
-			
 			// parse positional info
 			
-			string seqName;
-			lineStream >> seqName;
+			string_view seqName = splitToken(fields);
 			
 			if ( trackIndex >= lcb->regions.size() )
 			{
@@ -359,41 +367,47 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 				}
 			}
 			
-			int position;
-			int length;
-			char reverseChar;
-			int seqLength;
+			int position = parseInt(splitToken(fields));
+			int length = parseInt(splitToken(fields));
+			string_view strand = splitToken(fields);
+			int seqLength = parseInt(splitToken(fields));
 			
-			lineStream >> position >> length >> reverseChar >> seqLength;
-			
-			bool reverse = reverseChar == '-';
+			bool reverse = strand.size() && strand[0] == '-';
 			
 			if ( reverse )
 			{
 				position = seqLength - position - length; // MAF is stupid
 			}
 			
-			if ( regionOffsetBySeqNameByTrack[trackIndex].count(seqName) == 0 )
+			key.assign(seqName);
+			
+			unordered_map<string, int> & regionOffsetBySeqName = regionOffsetBySeqNameByTrack[trackIndex];
+			unordered_map<string, int>::iterator offsetFound = regionOffsetBySeqName.find(key);
+			
+			if ( offsetFound == regionOffsetBySeqName.end() )
 			{
 				// new sequence for this track; it's offset is the current total
 				
-				regionOffsetBySeqNameByTrack[trackIndex][seqName] = totalOffsetByTrack[trackIndex];
+				offsetFound = regionOffsetBySeqName.emplace(key, totalOffsetByTrack[trackIndex]).first;
 				totalOffsetByTrack[trackIndex] += seqLength;
 			}
 			
+			int regionOffset = offsetFound->second;
 			int refIndex;
 			
 			if ( trackIndex == 0 )
 			{
 				// translate ref seq name to index and create if needed
 				
-				try
+				unordered_map<string, int>::iterator refFound = refIndexByName.find(key);
+				
+				if ( refFound != refIndexByName.end() )
 				{
-					// check our local cache of names
+					// in our local cache of names
 					
-					refIndex = refIndexByName.at(seqName);
+					refIndex = refFound->second;
 				}
-				catch ( const out_of_range & e )
+				else
 				{
 					// not in local cache of names
 					
@@ -404,28 +418,21 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 						refIndex = refs.size();
 						refs.resize(refs.size() + 1);
 						refNames.resize(refNames.size() + 1);
-						refNames[refIndex] = seqName;
+						refNames[refIndex] = key;
 						refs[refIndex].resize(seqLength, 'N');
 						
-						refIndexByName[seqName] = refIndex;
+						refIndexByName[key] = refIndex;
 					}
 					else
 					{
-						// reference should already exist
+						// reference should already exist (throws
+						// NameNotFoundException if not)
 						
-						try
-						{
-							refIndex = referenceList->getReferenceSequenceFromName(seqName);
-						}
-						catch ( ReferenceList::NameNotFoundException & e )
-						{
-							// reference doesn't exist; error
-							throw;
-						}
+						refIndex = referenceList->getReferenceSequenceFromName(key);
 						
 						// cache for faster lookup next time
 						
-						refIndexByName[seqName] = refIndex;
+						refIndexByName[key] = refIndex;
 					}
 				}
 				
@@ -455,12 +462,7 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 					// destroy lcb and eat alignment
 					
 					lcbs.resize(lcbs.size() - 1);
-					
-					while ( in.peek() != '\n' )
-					{
-						in.ignore(numeric_limits<streamsize>::max(), '\n');
-					}
-					
+					skip = true;
 					lcb = 0;
 					
 					continue;
@@ -475,7 +477,7 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 			
 			LcbList::Region * region = &lcb->regions[trackIndex];
 			
-			region->position = position + regionOffsetBySeqNameByTrack[trackIndex][seqName];
+			region->position = position + regionOffset;
 			region->length = length;
 			region->reverse = reverse;
 			
@@ -483,12 +485,11 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 			
 			if ( trackIndex == 0 || variantList )
 			{
-				string seq;
-				lineStream >> seq;
+				string_view seq = splitToken(fields);
 				
 				if ( createReference && trackIndex == 0 )
 				{
-					string ungapped = seq;
+					string ungapped(seq);
 					ungap(ungapped);
 					
 					if ( lcbReverse )
@@ -503,31 +504,19 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 				
 				if ( variantList )
 				{
-					seqs[trackIndex] = seq;
+					seqs[trackIndex].assign(seq);
 				}
 			}
 		}
-		else if ( variantList && line[0] == 0 && lcb != 0 )
+		else if ( variantList && line.empty() && lcb != 0 )
 		{
-			for ( int i = 0; i < seqs.size(); i++ )
-			{
-				for ( int j = 0; j < seqs[i].length(); j++ )
-				{
-					seqs[i][j] = toupper(seqs[i][j]);
-				}
-			}
-			
-			variantList->addVariantsFromAlignment(seqs, *referenceList, lcb->sequence, lcb->position, lcb->length, lcbReverse);
-			
-			for ( int i = 0; i < seqs.size(); i++ )
-			{
-				seqs[i].clear();
-			}
-			
+			variantCaller.addAlignment(seqs, lcb->sequence, lcb->position, lcb->length, lcbReverse);
 			lcb = 0;
 		}
 	}
 	
+	variantCaller.finish();
+	
 	if ( queryCount && lcbs.size() == 0 )
 	{
 		throw NoCoreException(queryCount);
@@ -554,8 +543,6 @@ void LcbList::initFromMaf(const char * file, ReferenceList * referenceList, Trac
 	{
 		variantList->sortVariants();
 	}
-	
-	in.close();
 }
 
 void LcbList::initFromMfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList)
@@ -689,12 +676,20 @@ void LcbList::initFromProtocolBuffer(const Harvest::Alignment & msgAlignment)
 	}
 }
 
-void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList)
+void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, int threads)
 {
+	MappedFile mappedFile;
+	
+	if ( ! mappedFile.open(file) )
+	{
+		throw BadInputFileException();
+	}
+	
 	lcbs.resize(0);
 	
-	ifstream in(file);
-	char * line = new char[1 << 20];
+	const char * data = (const char *)mappedFile.getData();
+	const char * dataEnd = data + mappedFile.getSize();
+	string lineBuffer; // copy of the current header line, for tokenizing in place
 	int trackIndex = 0;
 	vector<string> seqs;
 	const bool oldTags = phylogenyTree->getRoot();
@@ -708,6 +703,11 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 		variantList->init();
 	}
 	
+	// variants are called on the pool while parsing continues
+	//
+	ThreadPool threadPool(variantList ? threads : 1);
+	VariantCaller variantCaller(variantList, referenceList, &threadPool);
+	
 	if ( oldTags )
 	{
 		trackIndecesNew = new int[trackList->getTrackCount()];
@@ -723,12 +723,29 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 	
 	TrackList::Track * track;
 	
-	while ( ! in.eof() )
+	// Walk the mapping a line at a time. Sequence lines are appended straight
+	// from the mapping, so lines can be any length. Everything is copied out,
+	// so pages already read are dropped as we go to keep the mapping from
+	// adding up to the size of the file.
+	
+	const char * dataStart = data;
+	const char * discarded = data;
+	string_view text;
+	
+	while ( nextLine(data, dataEnd, text) )
 	{
-		in.getline(line, (1 << 20) - 1);
+		char first = text.size() ? text[0] : 0;
+		
+		if ( data - discarded >= 1 << 24 )
+		{
+			mappedFile.discard(data - dataStart);
+			discarded = data;
+		}
 		
-		if ( *line == '#' )
+		if ( first == '#' )
 		{
+			lineBuffer.assign(text);
+			char * line = &lineBuffer[0];
 			char * suffix;
 			
 			if ( (suffix = removePrefix(line, "#FormatVersion ")) )
@@ -817,9 +834,10 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 				track->size = atoi(length_t.c_str());
 			}
 		}
-		else if ( *line == '>' )
+		else if ( first == '>' )
 		{
-			char * suffix = line + 1;
+			lineBuffer.assign(text);
+			char * suffix = &lineBuffer[1];
 			
 			while ( *suffix == ' ' )
 			{
@@ -886,7 +904,7 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 				}
 			}
 		}
-		else if ( variantList && *line == '=' )
+		else if ( variantList && first == '=' )
 		{
 			bool all = true;
 			
@@ -901,22 +919,20 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 			
 			if ( all )
 			{
-				for ( int i = 0; i < seqs.size(); i++ )
-				{
-					for ( int j = 0; j < seqs[i].length(); j++ )
-					{
-						seqs[i][j] = toupper(seqs[i][j]);
-					}
-				}
-				
 				if ( createReference )
 				{
 					string ungapped = seqs[0];
 					ungap(ungapped);
+					
+					for ( int i = 0; i < ungapped.length(); i++ )
+					{
+						ungapped[i] = toupper(ungapped[i]);
+					}
+					
 					ref.replace(lcb->position, ungapped.length(), ungapped);
 				}
 				
-				variantList->addVariantsFromAlignment(seqs, *referenceList, lcb->sequence, lcb->position, lcbLength);
+				variantCaller.addAlignment(seqs, lcb->sequence, lcb->position, lcbLength);
 			}
 			else
 			{
@@ -934,17 +950,17 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 		}
 		else if ( variantList )
 		{
-			seqs[trackIndex].append(line);
+			seqs[trackIndex].append(text);
 		}
 		
-		if ( *line != '=' && *line != '>' && *line != '#')
+		if ( first != '=' && first != '>' && first != '#')
 		{
 			if ( trackIndex == 0 )
 			{
-				lcbLength += strlen(line);
+				lcbLength += text.size();
 			}
 		}
-		else if (*line == '=')
+		else if (first == '=')
 		{
 			if ( lcb )
 			{
@@ -955,6 +971,8 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 		}
 	}
 	
+	variantCaller.finish();
+	
 	if ( oldTags )
 	{
 		trackList->setTracksByFile();
@@ -974,8 +992,6 @@ void LcbList::initFromXmfa(const char * file, ReferenceList * referenceList, Tra
 		variantList->sortVariants();
 	}
 	
-	delete [] line;
-	in.close();
 }
 
 void LcbList::initWithSingleLcb(const ReferenceList & referenceList, const TrackList & trackList)
@@ -1035,8 +1051,10 @@ void LcbList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
 	}
 }
 
-void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
+void LcbList::writeToMfa(ostream & stream, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
 {
+	OutputSink out(stream);
+	
 	// now iterate over alignments
 	
 	int totrefgaps = 0;
@@ -1048,7 +1066,7 @@ void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, con
 		int width = 80;
 		int col = 0;
 		
-		out << '>' << trackList.getTrack(i).file << endl;
+		out << '>' << trackList.getTrack(i).file << '\n';
 		
 		for ( int j = 0; j < lcbs.size(); j++ )
 		{
@@ -1065,7 +1083,7 @@ void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, con
 			{
 				currvarref = &variantList.getVariant(currvar);
 			
-				if ( currvarref->alleles[0] == '-' )
+				if ( variantList.getAllele(currvar, 0) == '-' )
 				{
 					currpos--;
 				}
@@ -1090,7 +1108,7 @@ void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, con
 				
 				if ( col == width )
 				{
-					out << endl;
+					out << '\n';
 					col = 0;
 				}
 				
@@ -1111,14 +1129,14 @@ void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, con
 					
 					if ( col == width )
 					{
-						out << endl;
+						out << '\n';
 						col = 0;
 					}
 				}
 				
 				if ( currvar < variantsSize && currpos == currvarref->position )
 				{
-					out << currvarref->alleles[i];
+					out << variantList.getAllele(currvar, i);
 					currvar++;
 					
 					if ( currvar < variantsSize )
@@ -1137,11 +1155,15 @@ void LcbList::writeToMfa(ostream & out, const ReferenceList & referenceList, con
 			
 		}
 		
-		out << endl;
+		out << '\n';
 	}
 }
-void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
+void LcbList::writeFilteredToMfa(ostream & stream, ostream & stream2, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
 {
+	OutputSink out(stream);
+	OutputSink outPositions(stream2);
+	OutputSink & out2 = &stream2 == &stream ? out : outPositions; // both may be stdout
+	
 	// now iterate over alignments
 	
 	int totrefgaps = 0;
@@ -1153,7 +1175,7 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 		int width = 80;
 		int col = 0;
 		
-		out << '>' << trackList.getTrack(i).file << endl;
+		out << '>' << trackList.getTrack(i).file << '\n';
 		
 		for ( int j = 0; j < lcbs.size(); j++ )
 		{
@@ -1170,7 +1192,7 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 			{
 				currvarref = &variantList.getVariant(currvar);
 			
-				if ( currvarref->alleles[0] == '-' )
+				if ( variantList.getAllele(currvar, 0) == '-' )
 				{
 					currpos--;
 				}
@@ -1195,7 +1217,7 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 				
 				if ( col == width )
 				{
-					out << endl;
+					out << '\n';
 					col = 0;
 				}
 				
@@ -1223,7 +1245,7 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 					
 					if ( col == width )
 					{
-						out << endl;
+						out << '\n';
 						col = 0;
 					}
 				}
@@ -1232,7 +1254,7 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 				{
 				  // ALB -- do not output if this SNP has been filtered for some reason
 				  if ( currvarref->filters == 0 ) {
-					out << currvarref->alleles[i];
+					out << variantList.getAllele(currvar, i);
 					if(i == 0) {
 					  out2 << currpos + 1 << ",";
 					}
@@ -1255,9 +1277,9 @@ void LcbList::writeFilteredToMfa(ostream & out, ostream & out2, const ReferenceL
 			
 		}
 		
-		out << endl;
+		out << '\n';
 		if(i == 0) {
-		  out2 << endl;
+		  out2 << '\n';
 		}
 	}
 }
@@ -1290,8 +1312,10 @@ void LcbList::writeToProtocolBuffer(Harvest * msg) const
 	}
 }
 
-void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
+void LcbList::writeToXmfa(ostream & stream, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const
 {
+	OutputSink out(stream);
+	
 /* EXAMPLE header
 #FormatVersion MultiSNiP
 #SequenceCount 8
@@ -1300,23 +1324,23 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 ##SequenceHeader >gi|76577973|gb|CP000124.1| Burkholderia pseudomallei 1710b chromosome I, complete sequence
 ##SequenceLength 4126292bp
 */
-	out << "#FormatVersion ParSNP v1.0" << endl;
-	out << "#SequenceCount " << trackList.getTrackCount() << endl;
+	out << "#FormatVersion ParSNP v1.0" << '\n';
+	out << "#SequenceCount " << trackList.getTrackCount() << '\n';
 	
 	for ( int i = 0; i < trackList.getTrackCount(); i++ )
 	{
 		const TrackList::Track & track = trackList.getTrack(i);
-		out << "##SequenceIndex " << i + 1 << endl;
-		out << "##SequenceFile " << track.file << endl;
-		out << "##SequenceHeader " << track.name << endl;
+		out << "##SequenceIndex " << i + 1 << '\n';
+		out << "##SequenceFile " << track.file << '\n';
+		out << "##SequenceHeader " << track.name << '\n';
 		
 		if ( track.size )
 		{
-			out << "##SequenceLength " << track.size << "bp" << endl;
+			out << "##SequenceLength " << track.size << "bp" << '\n';
 		}
 	}
 	
-	out << "#IntervalCount " << lcbs.size() << endl;
+	out << "#IntervalCount " << lcbs.size() << '\n';
 	
 	// now iterate over alignments
 	
@@ -1359,7 +1383,7 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 				out << "- ";
 			}
 			
-			out << "cluster" << j + 1 << endl;
+			out << "cluster" << j + 1 << '\n';
 			int currpos = refstart;
 			int width = 80;
 			int col = 0;
@@ -1370,7 +1394,7 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 			{
 				currvarref = &variantList.getVariant(currvar);
 			
-				if ( currvarref->alleles[0] == '-' )
+				if ( variantList.getAllele(currvar, 0) == '-' )
 				{
 					currpos--;
 				}
@@ -1397,7 +1421,7 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 				
 				if ( col == width )
 				{
-					out << endl;
+					out << '\n';
 					col = 0;
 				}
 				
@@ -1406,7 +1430,7 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 					currvar == variantsSize ||
 					(currpos != currvarref->position && currpos >= refstart) ||
 					(
-						currvarref->alleles[0] == '-' &&
+						variantList.getAllele(currvar, 0) == '-' &&
 						currvar > 0 &&
 						variantList.getVariant(currvar - 1).position != currpos &&
 						currpos >= refstart
@@ -1418,14 +1442,14 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 				
 					if ( col == width )
 					{
-						out << endl;
+						out << '\n';
 						col = 0;
 					}
 				}
 				
 				if ( currvar < variantsSize && currpos == currvarref->position )
 				{
-					out << currvarref->alleles[r];
+					out << variantList.getAllele(currvar, r);
 					currvar++;
 					
 					if ( currvar < variantsSize )
@@ -1442,9 +1466,9 @@ void LcbList::writeToXmfa(ostream & out, const ReferenceList & referenceList, co
 				}
 			}
 			
-			out << endl;
+			out << '\n';
 		}
 		
-		out << "=" << endl;
+		out << "=" << '\n';
 	}
 }
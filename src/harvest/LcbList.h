@@ -68,10 +68,10 @@ public:
         double getCoreSize() const;
 	int getLcbCount() const;
 	void initFromCapnp(const capnp::Harvest::Reader & harvestReader);
-	void initFromMaf(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, const char * referenceFileName);
+	void initFromMaf(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, const char * referenceFileName, int threads = 1);
 	void initFromMfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList);
 	void initFromProtocolBuffer(const Harvest::Alignment & msgAlignment);
-	void initFromXmfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList);
+	void initFromXmfa(const char * file, ReferenceList * referenceList, TrackList * trackList, PhylogenyTree * phylogenyTree, VariantList * variantList, int threads = 1);
 	void initWithSingleLcb(const ReferenceList & referenceList, const TrackList & trackList);
 	void writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const;
 	void writeToMfa(std::ostream & out, const ReferenceList & referenceList, const TrackList & trackList, const VariantList & variantList) const;
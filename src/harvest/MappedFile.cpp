@@ -0,0 +1,138 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+
+using namespace::std;
+
+MappedFile::MappedFile()
+{
+	data = 0;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()
+{
+	if ( size > 0 && buffer.empty() )
+	{
+		munmap((void *)data, size);
+	}
+	
+	vector<unsigned char>().swap(buffer);
+	data = 0;
+	size = 0;
+}
+
+void MappedFile::discard(size_t end)
+{
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	
+	end = (end < size ? end : size) / pageSize * pageSize;
+	
+	if ( end > 0 && buffer.empty() )
+	{
+		madvise((void *)data, end, MADV_DONTNEED);
+	}
+}
+
+bool MappedFile::open(const char * file)
+{
+	close();
+	
+	int fd = ::open(file, O_RDONLY);
+	
+	if ( fd < 0 )
+	{
+		return false;
+	}
+	
+	struct stat st;
+	
+	if ( fstat(fd, &st) < 0 )
+	{
+		::close(fd);
+		return false;
+	}
+	
+	if ( ! S_ISREG(st.st_mode) )
+	{
+		// no size to map; read until the end of the stream
+		
+		size_t length = 0;
+		
+		buffer.resize(1 << 20);
+		
+		while ( true )
+		{
+			ssize_t bytes = read(fd, buffer.data() + length, buffer.size() - length);
+			
+			if ( bytes < 0 && errno == EINTR )
+			{
+				continue;
+			}
+			
+			if ( bytes < 0 )
+			{
+				int error = errno;
+				
+				::close(fd);
+				vector<unsigned char>().swap(buffer);
+				errno = error;
+				return false;
+			}
+			
+			if ( bytes == 0 )
+			{
+				break;
+			}
+			
+			length += bytes;
+			
+			if ( length == buffer.size() )
+			{
+				buffer.resize(buffer.size() * 2);
+			}
+		}
+		
+		buffer.resize(length);
+		
+		if ( length > 0 )
+		{
+			data = buffer.data();
+			size = length;
+		}
+		else
+		{
+			vector<unsigned char>().swap(buffer);
+		}
+	}
+	else if ( st.st_size > 0 )
+	{
+		void * mapped = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		
+		if ( mapped == MAP_FAILED )
+		{
+			::close(fd);
+			return false;
+		}
+		
+		data = (const unsigned char *)mapped;
+		size = st.st_size;
+	}
+	
+	::close(fd); // the mapping stays valid
+	return true;
+}
@@ -0,0 +1,44 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <stddef.h>
+#include <vector>
+
+// Read-only memory mapping of a whole file. The mapping is page-aligned, so
+// data at word-aligned file offsets can be used in place. Files that can't be
+// mapped because they are not regular files (pipes, such as from process
+// substitution, or devices) are read into memory instead.
+//
+class MappedFile
+{
+public:
+	
+	MappedFile();
+	~MappedFile();
+	
+	void close();
+	void discard(size_t end); // drops resident pages before the offset; they are read again if used
+	const unsigned char * getData() const;
+	size_t getSize() const;
+	bool open(const char * file); // false (with errno set) if the file can't be mapped
+	
+private:
+	
+	MappedFile(const MappedFile &);
+	MappedFile & operator=(const MappedFile &);
+	
+	const unsigned char * data;
+	size_t size;
+	std::vector<unsigned char> buffer; // contents, if not mapped
+};
+
+inline const unsigned char * MappedFile::getData() const { return data; }
+inline size_t MappedFile::getSize() const { return size; }
+
+#endif
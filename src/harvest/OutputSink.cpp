@@ -0,0 +1,94 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/OutputSink.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace::std;
+
+OutputSink::OutputSink(ostream & outNew, size_t capacityNew)
+{
+	out = &outNew;
+	buffer.resize(capacityNew < 64 ? 64 : capacityNew);
+	used = 0;
+}
+
+OutputSink::~OutputSink()
+{
+	flush();
+}
+
+void OutputSink::flush()
+{
+	if ( used > 0 && out->rdbuf()->sputn(buffer.data(), used) != used )
+	{
+		out->setstate(ios::badbit);
+	}
+	
+	used = 0;
+}
+
+void OutputSink::write(const char * data, size_t length)
+{
+	if ( used + length > buffer.size() )
+	{
+		flush();
+		
+		if ( length > buffer.size() )
+		{
+			// too big to be worth buffering
+			
+			if ( out->rdbuf()->sputn(data, length) != length )
+			{
+				out->setstate(ios::badbit);
+			}
+			
+			return;
+		}
+	}
+	
+	memcpy(buffer.data() + used, data, length);
+	used += length;
+}
+
+OutputSink & OutputSink::operator<<(const char * string)
+{
+	write(string, strlen(string));
+	return *this;
+}
+
+OutputSink & OutputSink::operator<<(double value)
+{
+	// default ostream formatting is %g with a precision of 6
+	
+	char digits[32];
+	int length = snprintf(digits, sizeof(digits), "%g", value);
+	
+	write(digits, length);
+	return *this;
+}
+
+void OutputSink::writeInteger(unsigned long long value, bool negative)
+{
+	char digits[24];
+	char * end = digits + sizeof(digits);
+	char * start = end;
+	
+	do
+	{
+		*--start = '0' + value % 10;
+		value /= 10;
+	}
+	while ( value > 0 );
+	
+	if ( negative )
+	{
+		*--start = '-';
+	}
+	
+	write(start, end - start);
+}
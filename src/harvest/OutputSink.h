@@ -0,0 +1,77 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef OutputSink_h
+#define OutputSink_h
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Buffered text output for the writers. Formatting is done into a large
+// user-space buffer that is handed to the stream's buffer in bulk, bypassing
+// per-character ostream overhead; nothing is flushed until the buffer fills
+// or the sink is destroyed. Numbers are formatted as an ostream with default
+// flags would format them. The stream should not be written to directly
+// while a sink on it is alive.
+//
+class OutputSink
+{
+public:
+	
+	OutputSink(std::ostream & outNew, size_t capacityNew = 1 << 20);
+	~OutputSink();
+	
+	void flush(); // hands buffered output to the stream; the stream itself is not flushed
+	void put(char c);
+	void write(const char * data, size_t length);
+	
+	OutputSink & operator<<(char c);
+	OutputSink & operator<<(const char * string);
+	OutputSink & operator<<(const std::string & string);
+	OutputSink & operator<<(std::string_view string);
+	OutputSink & operator<<(int value);
+	OutputSink & operator<<(unsigned int value);
+	OutputSink & operator<<(long value);
+	OutputSink & operator<<(unsigned long value);
+	OutputSink & operator<<(long long value);
+	OutputSink & operator<<(unsigned long long value);
+	OutputSink & operator<<(double value);
+	
+private:
+	
+	OutputSink(const OutputSink &);
+	OutputSink & operator=(const OutputSink &);
+	
+	void writeInteger(unsigned long long value, bool negative);
+	
+	std::ostream * out;
+	std::vector<char> buffer;
+	size_t used;
+};
+
+inline void OutputSink::put(char c)
+{
+	if ( used == buffer.size() )
+	{
+		flush();
+	}
+	
+	buffer[used++] = c;
+}
+
+inline OutputSink & OutputSink::operator<<(char c) { put(c); return *this; }
+inline OutputSink & OutputSink::operator<<(const std::string & string) { write(string.data(), string.length()); return *this; }
+inline OutputSink & OutputSink::operator<<(std::string_view string) { write(string.data(), string.length()); return *this; }
+inline OutputSink & OutputSink::operator<<(int value) { writeInteger(value < 0 ? -(long long)value : value, value < 0); return *this; }
+inline OutputSink & OutputSink::operator<<(unsigned int value) { writeInteger(value, false); return *this; }
+inline OutputSink & OutputSink::operator<<(long value) { writeInteger(value < 0 ? -(unsigned long long)value : value, value < 0); return *this; }
+inline OutputSink & OutputSink::operator<<(unsigned long value) { writeInteger(value, false); return *this; }
+inline OutputSink & OutputSink::operator<<(long long value) { writeInteger(value < 0 ? -(unsigned long long)value : value, value < 0); return *this; }
+inline OutputSink & OutputSink::operator<<(unsigned long long value) { writeInteger(value, false); return *this; }
+
+#endif
@@ -329,8 +329,10 @@ void PhylogenyTree::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
 	root->writeToCapnp(rootBuilder);
 }
 
-void PhylogenyTree::writeToNewick(std::ostream &out, const TrackList & trackList, bool useMult) const
+void PhylogenyTree::writeToNewick(std::ostream &stream, const TrackList & trackList, bool useMult) const
 {
+	OutputSink out(stream);
+	
 	root->writeToNewick(out, trackList, useMult ? mult : 1);
 	out << ";\n";
 }
@@ -368,7 +368,7 @@ void PhylogenyTreeNode::writeToCapnp(capnp::Harvest::Tree::Node::Builder & nodeB
 	nodeBuilder.setBranchLength(distance);
 }
 
-void PhylogenyTreeNode::writeToNewick(std::ostream &out, const TrackList & trackList, const double mult) const
+void PhylogenyTreeNode::writeToNewick(OutputSink &out, const TrackList & trackList, const double mult) const
 {
 	if ( children.size() )
 	{
@@ -11,6 +11,7 @@
 #include <vector>
 #include "harvest/capnp/harvest.capnp.h"
 #include "harvest/pb/harvest.pb.h"
+#include "harvest/OutputSink.h"
 #include "harvest/TrackList.h"
 
 class PhylogenyTreeNode
@@ -47,7 +48,7 @@ public:
 	void setTrackId(int trackIdNew);
 	void swapSiblings();
 	void writeToCapnp(capnp::Harvest::Tree::Node::Builder & nodeBuilder) const;
-	void writeToNewick(std::ostream &out, const TrackList & trackList, const double mult = 1.0) const;
+	void writeToNewick(OutputSink &out, const TrackList & trackList, const double mult = 1.0) const;
 	void writeToProtocolBuffer(Harvest::Tree::Node * msgNode) const;
 	
 private:
@@ -6,58 +6,96 @@
 
 #include <fstream>
 #include "ReferenceList.h"
+#include "OutputSink.h"
+#include <algorithm>
 
 using namespace::std;
 
+ReferenceList::ReferenceList()
+{
+	offsets.push_back(0);
+}
+
 void ReferenceList::addReference(string name, string desc, string sequence)
 {
 	references.resize(references.size() + 1);
 	references[references.size() - 1].name = name;
 	references[references.size() - 1].description = desc;
 	references[references.size() - 1].sequence = sequence;
+	indexReference(references.size() - 1);
+}
+
+void ReferenceList::clear()
+{
+	references.resize(0);
+	indexReferences();
 }
 
 long int ReferenceList::getConcatenatedPosition(int sequence, long int position) const
 {
-	for ( int i = 0; i < sequence; i++ )
-	{
-		position += references.at(i).sequence.length();
-	}
-	
-	return position;
+	return sequence > 0 ? offsets.at(sequence) + position : position;
 }
 
 int ReferenceList::getPositionFromConcatenated(int sequence, long int position) const
 {
-	long int sum = 0;
+	return sequence > 0 ? position - offsets.at(sequence) : position;
+}
+
+int ReferenceList::getReferenceSequenceFromConcatenated(long int position) const
+{
+	// the first reference whose end is past the position
 	
-	for ( int i = 0; i < sequence; i++ )
+	vector<long int>::const_iterator end = upper_bound(offsets.begin() + 1, offsets.end(), position);
+	
+	if ( end == offsets.end() )
 	{
-		sum += references.at(i).sequence.length();
+		return undef;
 	}
 	
-	return position - sum;
+	return end - offsets.begin() - 1;
 }
 
-int ReferenceList::getReferenceSequenceFromConcatenated(long int position) const
+void ReferenceList::getReferenceSequencesFromConcatenated(const vector<long int> & positions, vector<int> & sequences) const
 {
-	long int sum = 0;
+	sequences.resize(positions.size());
 	
-	for ( int i = 0; i < references.size(); i++ )
+	// while positions are ascending, each search can start from the last
+	// reference found
+	
+	vector<long int>::const_iterator first = offsets.begin() + 1;
+	
+	for ( int i = 0; i < positions.size(); i++ )
 	{
-		sum += references.at(i).sequence.length();
+		if ( i > 0 && positions[i] < positions[i - 1] )
+		{
+			first = offsets.begin() + 1;
+		}
 		
-		if ( sum > position )
+		vector<long int>::const_iterator end = upper_bound(first, offsets.end(), positions[i]);
+		
+		if ( end == offsets.end() )
 		{
-			return i;
+			sequences[i] = undef;
+		}
+		else
+		{
+			sequences[i] = end - offsets.begin() - 1;
+			first = end;
 		}
 	}
-	
-	return undef;
 }
 
 int ReferenceList::getReferenceSequenceFromAcc(const string & acc) const
 {
+	unordered_map<string, int>::const_iterator token = indexByToken.find(acc);
+	
+	if ( token != indexByToken.end() )
+	{
+		return token->second;
+	}
+	
+	// not a whole token; fall back to any match within a name
+	
 	for ( int i = 0; i < references.size(); i++ )
 	{
 		size_t giToken = references.at(i).name.find(acc);
@@ -73,19 +111,28 @@ int ReferenceList::getReferenceSequenceFromAcc(const string & acc) const
 	return undef;
 }
 
-int ReferenceList::getReferenceSequenceFromName(string name) const
+int ReferenceList::getReferenceSequenceFromName(const string & name) const
 {
-	for ( int i = 0; i < references.size(); i++ )
+	unordered_map<string, int>::const_iterator index = indexByName.find(name);
+	
+	if ( index == indexByName.end() )
 	{
-		if ( name == references.at(i).name )
-		{
-			return i;
-		}
+		throw NameNotFoundException(name);
 	}
 	
-	throw NameNotFoundException(name);
+	return index->second;
+}
+
+void ReferenceList::getReferenceSequencesFromNames(const vector<string> & names, vector<int> & sequences) const
+{
+	sequences.resize(names.size());
 	
-	return undef;
+	for ( int i = 0; i < names.size(); i++ )
+	{
+		unordered_map<string, int>::const_iterator index = indexByName.find(names[i]);
+		
+		sequences[i] = index == indexByName.end() ? undef : index->second;
+	}
 }
 
 void ReferenceList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
@@ -104,6 +151,8 @@ void ReferenceList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
 		references[i].description = parseDescriptionFromTag(referenceReader.getTag());
 		references[i].sequence = referenceReader.getSequence();
 	}
+	
+	indexReferences();
 }
 
 void ReferenceList::initFromFasta(const char * file)
@@ -138,6 +187,7 @@ void ReferenceList::initFromFasta(const char * file)
 	}
 	
 	in.close();
+	indexReferences();
 }
 
 void ReferenceList::initFromProtocolBuffer(const Harvest::Reference & msg)
@@ -151,6 +201,8 @@ void ReferenceList::initFromProtocolBuffer(const Harvest::Reference & msg)
 		references[i].description = parseDescriptionFromTag(msg.references(i).tag());
 		references[i].sequence = msg.references(i).sequence();
 	}
+	
+	indexReferences();
 }
 
 void ReferenceList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
@@ -176,8 +228,10 @@ void ReferenceList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
 	}
 }
 
-void ReferenceList::writeToFasta(ostream & out) const
+void ReferenceList::writeToFasta(ostream & stream) const
 {
+	OutputSink out(stream);
+	
 	for ( int i = 0; i < references.size(); i++ )
 	{
 		out << '>' << references[i].name;
@@ -187,24 +241,22 @@ void ReferenceList::writeToFasta(ostream & out) const
 			out << ' ' << references[i].description;
 		}
 		
-		out << endl;
+		out << '\n';
 		
 		const string & sequence = references[i].sequence;
-		int width = 0;
+		int width = 70;
 		
-		for ( int j = 0; j < sequence.length(); j++ )
+		for ( int j = 0; j < sequence.length(); j += width )
 		{
-			if ( width == 70 )
+			if ( j > 0 )
 			{
-				out << endl;
-				width = 0;
+				out << '\n';
 			}
 			
-			out << sequence.at(j);
-			width++;
+			out.write(sequence.data() + j, min(sequence.length() - j, (size_t)width));
 		}
 		
-		out << endl;
+		out << '\n';
 	}
 }
 
@@ -227,6 +279,49 @@ void ReferenceList::writeToProtocolBuffer(Harvest * msg) const
 	}
 }
 
+void ReferenceList::indexReference(int index)
+{
+	const string & name = references[index].name;
+	
+	offsets.resize(index + 2);
+	offsets[index + 1] = offsets[index] + references[index].sequence.length();
+	
+	// emplace keeps the first reference for duplicates, as a scan would
+	
+	indexByName.emplace(name, index);
+	
+	size_t start = 0;
+	
+	while ( start <= name.length() )
+	{
+		size_t end = name.find('|', start);
+		
+		if ( end == string::npos )
+		{
+			end = name.length();
+		}
+		
+		if ( end > start )
+		{
+			indexByToken.emplace(name.substr(start, end - start), index);
+		}
+		
+		start = end + 1;
+	}
+}
+
+void ReferenceList::indexReferences()
+{
+	offsets.assign(1, 0);
+	indexByName.clear();
+	indexByToken.clear();
+	
+	for ( int i = 0; i < references.size(); i++ )
+	{
+		indexReference(i);
+	}
+}
+
 string parseNameFromTag(string tag)
 {
 	for ( int i = 0; i < tag.length(); i++ )
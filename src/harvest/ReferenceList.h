@@ -8,6 +8,7 @@
 #define ReferenceList_h
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
@@ -56,6 +57,8 @@ public:
 		std::string name;
 	};
 	
+	ReferenceList();
+	
 	void addReference(std::string name, std::string desc, std::string sequence);
 	void clear();
 	long int getConcatenatedPosition(int sequence, long int position) const;
@@ -63,8 +66,10 @@ public:
 	const Reference & getReference(int index) const;
 	int getReferenceCount() const;
 	int getReferenceSequenceFromConcatenated(long int position) const;
+	void getReferenceSequencesFromConcatenated(const std::vector<long int> & positions, std::vector<int> & sequences) const; // fastest with sorted positions
 	int getReferenceSequenceFromAcc(const std::string & acc) const;
-	int getReferenceSequenceFromName(std::string name) const;
+	int getReferenceSequenceFromName(const std::string & name) const;
+	void getReferenceSequencesFromNames(const std::vector<std::string> & names, std::vector<int> & sequences) const; // undef for names not found
 	void initFromCapnp(const capnp::Harvest::Reader & harvestReader);
 	void initFromFasta(const char * file);
 	void initFromProtocolBuffer(const Harvest::Reference & msg);
@@ -74,13 +79,22 @@ public:
 	
 private:
 	
+	void indexReference(int index);
+	void indexReferences();
+	
 	std::vector<Reference> references;
+	std::vector<long int> offsets; // concatenated position of each reference, plus the total length
+	
+	// first reference with each name, and with each "|"-delimited token of
+	// a name (e.g. the accession in "gi|49175990|ref|NC_000913.3|")
+	//
+	std::unordered_map<std::string, int> indexByName;
+	std::unordered_map<std::string, int> indexByToken;
 };
 
 std::string parseNameFromTag(std::string tag);
 std::string parseDescriptionFromTag(std::string tag);
 
-inline void ReferenceList::clear() { references.resize(0); }
 inline int ReferenceList::getReferenceCount() const { return references.size(); }
 inline const Reference & ReferenceList::getReference(int index) const { return references.at(index); }
 
@@ -0,0 +1,136 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/ThreadPool.h"
+
+using namespace::std;
+
+ThreadPool::ThreadPool(int threadCountNew)
+{
+	threadCount = threadCountNew < 1 ? 1 : threadCountNew;
+	pending = 0;
+	stopping = false;
+	
+	if ( threadCount > 1 )
+	{
+		for ( int i = 0; i < threadCount; i++ )
+		{
+			threads.push_back(thread(&ThreadPool::work, this));
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		unique_lock<std::mutex> lock(jobMutex);
+		
+		while ( pending > 0 )
+		{
+			jobsDone.wait(lock);
+		}
+		
+		stopping = true;
+	}
+	
+	jobReady.notify_all();
+	
+	for ( int i = 0; i < threads.size(); i++ )
+	{
+		threads[i].join();
+	}
+}
+
+void ThreadPool::run(const function<void()> & job)
+{
+	if ( threads.size() == 0 )
+	{
+		try
+		{
+			job();
+		}
+		catch ( ... )
+		{
+			if ( ! exception )
+			{
+				exception = current_exception();
+			}
+		}
+		
+		return;
+	}
+	
+	{
+		unique_lock<std::mutex> lock(jobMutex);
+		jobs.push(job);
+		pending++;
+	}
+	
+	jobReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	unique_lock<std::mutex> lock(jobMutex);
+	
+	while ( pending > 0 )
+	{
+		jobsDone.wait(lock);
+	}
+	
+	if ( exception )
+	{
+		exception_ptr thrown = exception;
+		exception = exception_ptr();
+		rethrow_exception(thrown);
+	}
+}
+
+void ThreadPool::work()
+{
+	while ( true )
+	{
+		function<void()> job;
+		
+		{
+			unique_lock<std::mutex> lock(jobMutex);
+			
+			while ( jobs.empty() && ! stopping )
+			{
+				jobReady.wait(lock);
+			}
+			
+			if ( jobs.empty() )
+			{
+				return;
+			}
+			
+			job = jobs.front();
+			jobs.pop();
+		}
+		
+		try
+		{
+			job();
+		}
+		catch ( ... )
+		{
+			unique_lock<std::mutex> lock(jobMutex);
+			
+			if ( ! exception )
+			{
+				exception = current_exception();
+			}
+		}
+		
+		{
+			unique_lock<std::mutex> lock(jobMutex);
+			pending--;
+		}
+		
+		jobsDone.notify_all();
+	}
+}
@@ -0,0 +1,50 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads. With fewer than two threads, jobs are
+// run immediately on the calling thread, so single-threaded behavior does not
+// depend on the pool at all.
+//
+class ThreadPool
+{
+public:
+	
+	ThreadPool(int threadCountNew);
+	~ThreadPool();
+	
+	int getThreadCount() const;
+	void run(const std::function<void()> & job);
+	void wait(); // blocks until all jobs finish; rethrows the first exception
+	
+private:
+	
+	void work();
+	
+	int threadCount;
+	int pending;
+	bool stopping;
+	std::exception_ptr exception;
+	std::vector<std::thread> threads;
+	std::queue<std::function<void()> > jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobsDone;
+};
+
+inline int ThreadPool::getThreadCount() const { return threadCount; }
+
+#endif
@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 enum TrackType
 {
@@ -76,7 +77,7 @@ private:
 	
 	std::vector<Track> tracks;
 	int trackReference;
-	std::map<std::string, int> tracksByFile;
+	std::unordered_map<std::string, int> tracksByFile;
 };
 
 inline const TrackList::Track & TrackList::getTrack(int index) const { return tracks[index]; }
@@ -0,0 +1,90 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/VariantCaller.h"
+#include <ctype.h>
+
+using namespace::std;
+
+VariantCaller::VariantCaller(VariantList * variantListNew, const ReferenceList * referenceListNew, ThreadPool * threadPoolNew)
+{
+	variantList = variantListNew;
+	referenceList = referenceListNew;
+	threadPool = threadPoolNew;
+	blocksMax = threadPool->getThreadCount() * 4;
+}
+
+void VariantCaller::addAlignment(vector<string> & seqs, int sequence, int position, int length, bool reverse)
+{
+	shared_ptr<Block> block(new Block());
+	
+	block->seqs.resize(seqs.size());
+	
+	for ( int i = 0; i < seqs.size(); i++ )
+	{
+		block->seqs[i].swap(seqs[i]);
+	}
+	
+	block->sequence = sequence;
+	block->position = position;
+	block->length = length;
+	block->reverse = reverse;
+	block->variants.setWindowFilters(variantList->getFilterWindow(), variantList->getConservationMin(), variantList->getGapMax());
+	block->done = block->called.get_future();
+	
+	blocks.push_back(block);
+	
+	const ReferenceList * references = referenceList;
+	
+	threadPool->run([block, references]()
+	{
+		try
+		{
+			for ( int i = 0; i < block->seqs.size(); i++ )
+			{
+				string & seq = block->seqs[i];
+				
+				for ( int j = 0; j < seq.length(); j++ )
+				{
+					seq[j] = toupper(seq[j]);
+				}
+			}
+			
+			block->variants.addVariantsFromAlignment(block->seqs, *references, block->sequence, block->position, block->length, block->reverse);
+			block->seqs.clear();
+			block->called.set_value();
+		}
+		catch ( ... )
+		{
+			block->called.set_exception(current_exception());
+		}
+	});
+	
+	// append finished blocks as soon as possible to keep memory down, and
+	// wait for the oldest once too many are held
+	
+	while ( blocks.size() && (blocks.size() >= blocksMax || blocks.front()->done.wait_for(chrono::seconds(0)) == future_status::ready) )
+	{
+		appendNext();
+	}
+}
+
+void VariantCaller::appendNext()
+{
+	shared_ptr<Block> block = blocks.front();
+	
+	blocks.pop_front();
+	block->done.get();
+	variantList->appendVariants(block->variants);
+}
+
+void VariantCaller::finish()
+{
+	while ( blocks.size() )
+	{
+		appendNext();
+	}
+}
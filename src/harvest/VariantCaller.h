@@ -0,0 +1,59 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef VariantCaller_h
+#define VariantCaller_h
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "harvest/ThreadPool.h"
+#include "harvest/VariantList.h"
+
+// Calls variants in aligned blocks on a thread pool while the caller keeps
+// parsing. Each block's variants go to a buffer of their own, and buffers are
+// appended to the target list in the order their blocks were added, so the
+// result is the same as calling addVariantsFromAlignment on each block in
+// turn. At most a few blocks per thread are held at once.
+//
+class VariantCaller
+{
+public:
+	
+	VariantCaller(VariantList * variantListNew, const ReferenceList * referenceListNew, ThreadPool * threadPoolNew);
+	
+	void addAlignment(std::vector<std::string> & seqs, int sequence, int position, int length, bool reverse = false); // takes the contents of seqs, leaving empty strings
+	void finish(); // waits for all blocks and appends the rest of their variants
+	
+private:
+	
+	struct Block
+	{
+		std::vector<std::string> seqs;
+		int sequence;
+		int position;
+		int length;
+		bool reverse;
+		VariantList variants;
+		std::promise<void> called;
+		std::future<void> done;
+	};
+	
+	VariantCaller(const VariantCaller &);
+	VariantCaller & operator=(const VariantCaller &);
+	
+	void appendNext(); // waits for the oldest block; rethrows its exception
+	
+	VariantList * variantList;
+	const ReferenceList * referenceList;
+	ThreadPool * threadPool;
+	std::deque<std::shared_ptr<Block> > blocks;
+	int blocksMax;
+};
+
+#endif
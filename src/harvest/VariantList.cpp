@@ -5,14 +5,214 @@
 // See the LICENSE.txt file included with this software for license information.
 
 #include "harvest/VariantList.h"
+#include <errno.h>
 #include <fstream>
 #include <sstream>
+#include "harvest/OutputSink.h"
 #include "harvest/parse.h"
+#include "harvest/scan.h"
+#include "harvest/ThreadPool.h"
+#include "harvest/zblock.h"
 #include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <algorithm>
 
 using namespace::std;
 
+// Spilled runs are sorted, so each variant is stored relative to the one
+// before it as varints, followed by its alleles packed two to a byte as codes
+// into "ACGTN-". Any other allele is stored as an escape code, with the
+// character itself following the packed alleles.
+
+static const char * spillAlphabet = "ACGTN-";
+static const int spillEscape = 15;
+
+static int getSpillCode(char allele)
+{
+	switch ( allele )
+	{
+		case 'A': return 0;
+		case 'C': return 1;
+		case 'G': return 2;
+		case 'T': return 3;
+		case 'N': return 4;
+		case '-': return 5;
+		default: return spillEscape;
+	}
+}
+
+static void putVarint(string & buffer, unsigned long long value)
+{
+	while ( value >= 0x80 )
+	{
+		buffer.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	
+	buffer.push_back((char)value);
+}
+
+static void putSigned(string & buffer, long long value)
+{
+	putVarint(buffer, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63)); // zigzag
+}
+
+static void encodeVariant(string & buffer, const VariantList::Variant & variant, const VariantList::Variant & previous, const string & row)
+{
+	putSigned(buffer, variant.sequence - previous.sequence);
+	putSigned(buffer, variant.sequence == previous.sequence ? variant.position - previous.position : variant.position);
+	putVarint(buffer, variant.offset);
+	buffer.push_back(variant.reference);
+	putVarint(buffer, variant.filters);
+	putSigned(buffer, variant.quality);
+	
+	for ( int i = 0; i < row.length(); i += 2 )
+	{
+		int low = getSpillCode(row[i]);
+		int high = i + 1 < row.length() ? getSpillCode(row[i + 1]) : 0;
+		
+		buffer.push_back((char)(low | high << 4));
+	}
+	
+	for ( int i = 0; i < row.length(); i++ )
+	{
+		if ( getSpillCode(row[i]) == spillEscape )
+		{
+			buffer.push_back(row[i]);
+		}
+	}
+}
+
+// Reads one spilled run from start to end. Reads are positioned, so any
+// number of readers can share the file.
+//
+class SpillReader
+{
+public:
+	
+	SpillReader(int fdNew, size_t sizeNew)
+	{
+		fd = fdNew;
+		size = sizeNew;
+		offset = 0;
+		buffer.resize(1 << 16);
+		bufferPos = 0;
+		bufferEnd = 0;
+		previous.sequence = 0;
+		previous.position = 0;
+	}
+	
+	void read(VariantList::Variant & variant, string & row)
+	{
+		variant.sequence = previous.sequence + getSigned();
+		variant.position = getSigned() + (variant.sequence == previous.sequence ? previous.position : 0);
+		variant.offset = getVarint();
+		variant.reference = getByte();
+		variant.filters = getVarint();
+		variant.quality = getSigned();
+		
+		escapes.clear();
+		
+		for ( int i = 0; i < row.length(); i++ )
+		{
+			if ( i % 2 == 0 )
+			{
+				pair = getByte();
+			}
+			
+			int code = i % 2 ? pair >> 4 : pair & 0xf;
+			
+			if ( code == spillEscape )
+			{
+				escapes.push_back(i);
+			}
+			else
+			{
+				row[i] = spillAlphabet[code];
+			}
+		}
+		
+		for ( int i = 0; i < escapes.size(); i++ )
+		{
+			row[escapes[i]] = getByte();
+		}
+		
+		previous = variant;
+	}
+	
+private:
+	
+	unsigned char getByte()
+	{
+		if ( bufferPos == bufferEnd )
+		{
+			size_t length = min(buffer.size(), size - offset);
+			ssize_t got = length ? pread(fd, &buffer[0], length, offset) : 0;
+			
+			if ( got <= 0 )
+			{
+				cerr << "ERROR: could not read temporary variant file (" << (got < 0 ? strerror(errno) : "unexpected end") << ")\n";
+				exit(1);
+			}
+			
+			offset += got;
+			bufferPos = 0;
+			bufferEnd = got;
+		}
+		
+		return buffer[bufferPos++];
+	}
+	
+	long long getSigned()
+	{
+		unsigned long long value = getVarint();
+		
+		return (long long)(value >> 1) ^ -(long long)(value & 1);
+	}
+	
+	unsigned long long getVarint()
+	{
+		unsigned long long value = 0;
+		int shift = 0;
+		unsigned char byte;
+		
+		do
+		{
+			byte = getByte();
+			value |= (unsigned long long)(byte & 0x7f) << shift;
+			shift += 7;
+		}
+		while ( byte & 0x80 );
+		
+		return value;
+	}
+	
+	int fd;
+	size_t size;
+	size_t offset;
+	vector<unsigned char> buffer;
+	size_t bufferPos;
+	size_t bufferEnd;
+	VariantList::Variant previous;
+	unsigned char pair;
+	vector<int> escapes;
+};
+
+VariantList::VariantList()
+{
+	window = 100;
+	conservationMin = 0.5;
+	gapMax = 0.2;
+	memoryLimit = 0;
+}
+
+VariantList::~VariantList()
+{
+	closeSpills();
+}
+
 bool operator<(const VariantList::VariantSortKey & a, const VariantList::VariantSortKey & b)
 {
 	if ( a.sequence == b.sequence )
@@ -92,73 +292,54 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 {
 //	Harvest::Variation * msg = harvest.mutable_variation();
 	char col[seqs.size() + 1];
-        //add arrays for tracking conserved,poorly aligned columns
-	vector<bool> conserved(seqs[0].length()+1,true);
-	vector<bool> gaps(seqs[0].length()+1,false);
-	vector<bool> nns(seqs[0].length()+1,false);
 	int offset = 0;
 	
 	col[seqs.size()] = 0; // null-terminate for use as a c-style string
 	
-        //simple loop to check for column conservation
-        //this could be done via SP-score all-v-all pairs
-        //but for now, simply use to flag SNPs that are within a window of 100bp
-        //with less than 50% column conservation (w.r.t ref, not consensus)
-	for ( int i = 0; i < seqs[0].length(); i++ )
+	// Classify all columns in one pass. Columns are conserved if they have
+	// at most one of A, C, G, T and gap (w.r.t. all sequences, not
+	// consensus); SNPs are later flagged if they are within a window
+	// (100bp by default) with less than 50% column conservation.
+	//
+	vector<unsigned char> flags;
+	//
+	scanColumns(seqs, flags);
+	//
+	if ( reverse )
 	{
-		bool variant = false;
-		bool indel = false;
-		vector<int> nt_cnt(5,0);
-		//vector<int>::iterator maxval;
-		
-		for (int j = 0; j < seqs.size(); j++)
-		{
-			if ( reverse )
-			{
-				col[j] = seqs[j][seqs[0].length() - i - 1];
-			}
-			else
-			{
-				col[j] = seqs[j][i];
-			}
-
-  		    if (col[j] == 'a' || col[j] == 'A')
-		      nt_cnt[0] =1;
-  		    else if (col[j] == 't' || col[j] == 'T')
-		      nt_cnt[1] =1;
-  		    else if (col[j] == 'g' || col[j] == 'G')
-		      nt_cnt[2] =1;
-  		    else if (col[j] == 'c' || col[j] == 'C')
-		      nt_cnt[3] =1;
-  		    else if (col[j] == 'n' || col[j] == 'N')
-		      nns[i] = true;
-  		    else if (col[j] == '-')
-		    {
-		      gaps[i] = true;
-                      nt_cnt[4] = 1;
-		    }
-                }
-                //maxval = std::max_element(nt_cnt.begin(),nt_cnt.end());
-                if ((nt_cnt[0] + nt_cnt[1] + nt_cnt[2] + nt_cnt[3] +nt_cnt[4]) > 1)
-                  conserved[i] = false;
-                /*multi-allelic
-                if ((nt_cnt[0] + nt_cnt[1] + nt_cnt[2] + nt_cnt[3] +nt_cnt[4]) > 2)
-		{
-		  conserved[i] = false;
-		}
-                */
+		std::reverse(flags.begin(), flags.end());
+	}
+	
+	// Running counts of conserved and gapped columns, so each SNP's window
+	// can be counted in constant time. Column i is counted in entry i + 1;
+	// the column past the end counts as conserved and ungapped.
+	//
+	int length0 = seqs[0].length();
+	vector<int> conservedSums(length0 + 2, 0);
+	vector<int> gapSums(length0 + 2, 0);
+	
+	for ( int i = 0; i < length0; i++ )
+	{
+		conservedSums[i + 1] = conservedSums[i] + ((flags[i] & COLUMN_conserved) ? 1 : 0);
+		gapSums[i + 1] = gapSums[i] + ((flags[i] & COLUMN_gap) ? 1 : 0);
 	}
 	
+	conservedSums[length0 + 1] = conservedSums[length0] + 1;
+	gapSums[length0 + 1] = gapSums[length0];
+	
 	// Since insertions to the reference take on the left-most reference
 	// position, this allows the alignment to start with an insertion
 	// (possibly at reference position -1).
 	//
 	position--;
 	
+	runStarts.push_back(variants.size());
+	
 	for ( int i = 0; i < seqs[0].length(); i++ )
 	{
-		bool variant = false;
-		bool n = false;
+		bool variant = flags[i] & COLUMN_variant;
+		bool n = flags[i] & COLUMN_n;
+		bool indel = flags[i] & COLUMN_gap;
 		
 		if ( reverse )
 		{
@@ -169,9 +350,7 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 			col[0] = seqs[0][i];
 		}
 		
-		bool indel = col[0] == '-';
-		
-		if ( indel )
+		if ( col[0] == '-' )
 		{
 			// insertion relative to the reference
 			offset++;
@@ -182,30 +361,18 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 			offset = 0;
 		}
 		
-		for ( int j = 1; j < seqs.size(); j++ )
+		if ( variant )
 		{
-			if ( reverse )
-			{
-				col[j] = seqs[j][seqs[0].length() - i - 1];
-			}
-			else
-			{
-				col[j] = seqs[j][i];
-			}
-		
-			if ( ! variant && col[j] != col[0] )
-			{
-				variant = true;
-			}
-			
-			if ( ! indel && col[j] == '-' )
-			{
-				indel = true;
-			}
-			
-			if ( col[j] == 'N' || col[j] == 'n' )
+			for ( int j = 1; j < seqs.size(); j++ )
 			{
-				n = true;
+				if ( reverse )
+				{
+					col[j] = seqs[j][seqs[0].length() - i - 1];
+				}
+				else
+				{
+					col[j] = seqs[j][i];
+				}
 			}
 		}
 		
@@ -220,46 +387,39 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 				sequence++;
 			}
 			
+			// The left side of the window stops short of the first column
+			// (and counts as -1 wide at the first column itself); this is
+			// kept for consistency with earlier filtering.
+			//
 			int windowsize = 0;
-                        int window = 50;
-                        if (window > i)
-			{
-			  window = i -1;
-			}
-                        windowsize+=window;
-                        int conserved_cnt = 0;
-                        int gap_cnt = 0;
-                        for (int z = 1; z<=window;z++)
+			int conserved_cnt = 0;
+			int gap_cnt = 0;
+			int side = window / 2;
+			
+			if ( side > i )
 			{
-			  if (conserved.at(i-z))
-			  {
-			    conserved_cnt+=1;
-			  }
-
-			  if (gaps.at(i-z))
-			  {
-			    gap_cnt+=1;
-			  }
-            
+				side = i - 1;
 			}
-                        window = 50;
-                        if (window+i > seqs[0].length())
+			
+			windowsize += side;
+			
+			if ( side > 0 )
 			{
-			  window = seqs[0].length() - i;
+				conserved_cnt += conservedSums[i] - conservedSums[i - side];
+				gap_cnt += gapSums[i] - gapSums[i - side];
 			}
-                        windowsize+=window;
-                        for (int z = 1; z<=window;z++)
+			
+			side = window / 2;
+			
+			if ( side + i > length0 )
 			{
-			  if (conserved.at(i+z))
-			  {
-			    conserved_cnt+=1;
-			  }
-			  if (gaps.at(i+z))
-			  {
-			    gap_cnt+=1;
-			  }
+				side = length0 - i;
 			}
 			
+			windowsize += side;
+			conserved_cnt += conservedSums[i + side + 1] - conservedSums[i + 1];
+			gap_cnt += gapSums[i + side + 1] - gapSums[i + 1];
+			
 			if ( reverse )
 			{
 				for ( int j = 0; j < seqs.size(); j++ )
@@ -288,7 +448,7 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 				varNew->reference = col[0];
 			}
 			
-			varNew->alleles = col;
+			alleles.addRow(col, seqs.size());
 			varNew->filters = 0;
 			
 			if ( indel )
@@ -306,11 +466,12 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 				varNew->filters |= FILTER_lcb;
 			}
 			
-                        if ( ((float)conserved_cnt/(float)windowsize) < 0.5 )
+			if ( ((float)conserved_cnt/(float)windowsize) < conservationMin )
 			{
 				varNew->filters |= FILTER_conservation;
 			}
-                        if ( ((float)gap_cnt/(float)windowsize) > 0.2 )
+			
+			if ( ((float)gap_cnt/(float)windowsize) > gapMax )
 			{
 				varNew->filters |= FILTER_gaps;
 			}
@@ -320,10 +481,42 @@ void VariantList::addVariantsFromAlignment(const vector<string> & seqs, const Re
 	}
 }
 
+void VariantList::appendVariants(VariantList & other)
+{
+	for ( int i = 0; i < other.runStarts.size(); i++ )
+	{
+		runStarts.push_back(variants.size() + other.runStarts[i]);
+	}
+	
+	if ( variants.size() == 0 )
+	{
+		variants.swap(other.variants);
+	}
+	else
+	{
+		variants.insert(variants.end(), other.variants.begin(), other.variants.end());
+		other.variants.clear();
+	}
+	
+	alleles.appendRows(other.alleles);
+	other.alleles.clear();
+	other.runStarts.clear();
+	
+	// leave room for vector growth and the copies made while sorting
+	
+	if ( memoryLimit && variants.size() * sizeof(Variant) + alleles.getByteCount() > memoryLimit / 3 )
+	{
+		spill();
+	}
+}
+
 void VariantList::clear()
 {
 	filters.clear();
 	variants.clear();
+	alleles.clear();
+	runStarts.clear();
+	closeSpills();
 }
 
 void VariantList::init()
@@ -332,10 +525,20 @@ void VariantList::init()
 	addFilter(FILTER_indel, "IND", "Column contains indel");
 	addFilter(FILTER_n, "N", "Column contains N");
 	addFilter(FILTER_lcb, "LCB", "LCB smaller than 200bp");
-	addFilter(FILTER_conservation, "CID", "SNP in aligned 100bp window with < 50% column % ID");
-	addFilter(FILTER_gaps, "ALN", "SNP in aligned 100b window with > 20 indels");
+	
+	ostringstream descConservation;
+	ostringstream descGaps;
+	
+	descConservation << "SNP in aligned " << window << "bp window with < " << conservationMin * 100 << "% column % ID";
+	descGaps << "SNP in aligned " << window << "b window with > " << gapMax * window << " indels";
+	
+	addFilter(FILTER_conservation, "CID", descConservation.str());
+	addFilter(FILTER_gaps, "ALN", descGaps.str());
 	
 	variants.resize(0);
+	alleles.clear();
+	runStarts.clear();
+	closeSpills();
 }
 
 void VariantList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
@@ -357,6 +560,9 @@ void VariantList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
 	}
 	
 	variants.resize(variantListReader.getVariants().size());
+	alleles.clear();
+	runStarts.clear();
+	closeSpills();
 	auto variantsReader = variantListReader.getVariants();
 	
 	for ( int i = 0; i < variants.size(); i++ )
@@ -366,12 +572,12 @@ void VariantList::initFromCapnp(const capnp::Harvest::Reader & harvestReader)
 		
 		variant.sequence = variantReader.getSequence();
 		variant.position = variantReader.getPosition();
-		variant.alleles = variantReader.getAlleles();
+		capnp::Text::Reader allelesReader = variantReader.getAlleles();
+		alleles.addRow(allelesReader.cStr(), allelesReader.size());
 		variant.filters = variantReader.getFilters();
 		variant.quality = variantReader.getQuality();
 		variant.reference = variantReader.getReference();
 		
-		//printf("VARIANT: %d\t%d\t%s\t%ld\t%d\n", variant.sequence, variant.position, variant.alleles.c_str(), variant.filters, variant.quality);
 	}
 }
 
@@ -388,6 +594,9 @@ void VariantList::initFromProtocolBuffer(const Harvest::Variation & msgVariation
 	}
 	
 	variants.resize(msgVariation.variants_size());
+	alleles.clear();
+	runStarts.clear();
+	closeSpills();
 	
 	for ( int i = 0; i < msgVariation.variants_size(); i++ )
 	{
@@ -397,7 +606,7 @@ void VariantList::initFromProtocolBuffer(const Harvest::Variation & msgVariation
 		
 		variant.sequence = msgVariant.sequence();
 		variant.position = msgVariant.position();
-		variant.alleles = msgVariant.alleles();
+		alleles.addRow(msgVariant.alleles().c_str(), msgVariant.alleles().length());
 		variant.filters = msgVariant.filters();
 		variant.quality = msgVariant.quality();
 		
@@ -407,7 +616,7 @@ void VariantList::initFromProtocolBuffer(const Harvest::Variation & msgVariation
 		}
 		else
 		{
-			variant.reference = variant.alleles[0];
+			variant.reference = msgVariant.alleles()[0];
 		}
 	}
 }
@@ -416,6 +625,9 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 {
 	filters.resize(0);
 	variants.resize(0);
+	alleles.clear();
+	runStarts.clear();
+	closeSpills();
 	
 	ifstream in(file);
 	
@@ -434,6 +646,11 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 	//
 	set<VariantSortKey> ambiguousIndels;
 	
+	// Alleles are filled in piecemeal, so they are kept as strings (parallel
+	// to variants) until all lines have been read.
+	//
+	vector<string> alleleRows;
+	
 	string line;
 	map<string, long long int> flagsByFilter;
 	map<string, int> refByTag;
@@ -662,6 +879,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						if ( variantIndecesBySortKey.count(key) )
 						{
 							variants.erase(variants.begin() + variantIndecesBySortKey.at(key));
+							alleleRows.erase(alleleRows.begin() + variantIndecesBySortKey.at(key));
 						}
 						
 						ambiguousIndels.insert(key);
@@ -671,6 +889,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 					
 					VariantSortKey key(sequence, positionVariant, offset);
 					Variant * variant;
+					string * variantAlleles;
 					
 					if ( ambiguousIndels.count(key) )
 					{
@@ -687,6 +906,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						if ( variantIndecesBySortKey.count(key) )
 						{
 							variants.erase(variants.begin() + variantIndecesBySortKey.at(key));
+							alleleRows.erase(alleleRows.begin() + variantIndecesBySortKey.at(key));
 						}
 						
 						ambiguousIndels.insert(key);
@@ -696,6 +916,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						if ( variantIndecesBySortKey.count(keyInsertion) )
 						{
 							variants.erase(variants.begin() + variantIndecesBySortKey.at(keyInsertion));
+							alleleRows.erase(alleleRows.begin() + variantIndecesBySortKey.at(keyInsertion));
 						}
 						
 						ambiguousIndels.insert(keyInsertion);
@@ -708,6 +929,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						// existing variant at this column
 						
 						variant = & variants[variantIndecesBySortKey.at(key)];
+						variantAlleles = & alleleRows[variantIndecesBySortKey.at(key)];
 						
 						// use the minimum quality to be conservative
 						//
@@ -725,6 +947,8 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						variantIndecesBySortKey[key] = variants.size();
 						variants.resize(variants.size() + 1);
 						variant = & variants[variants.size() - 1];
+						alleleRows.resize(alleleRows.size() + 1);
+						variantAlleles = & alleleRows[alleleRows.size() - 1];
 						
 						if ( offset )
 						{
@@ -740,7 +964,7 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 						variant->offset = offset;
 						variant->quality = quality;
 						variant->filters = filters;
-						variant->alleles.resize(trackList->getTrackCount(), 0);
+						variantAlleles->resize(trackList->getTrackCount(), 0);
 					}
 					
 					char snp;
@@ -763,18 +987,18 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 							
 							char snpAllele = alleleIndeces[k] == -1 ? 'N' : snp;
 							
-							if ( variant->alleles[k] != 0 && variant->alleles[k] != snpAllele)
+							if ( (*variantAlleles)[k] != 0 && (*variantAlleles)[k] != snpAllele)
 							{
 								throw ConflictingVariantException
 								(
 									lineIndex,
 									trackList->getTrack(k).file,
-									variant->alleles[k],
+									(*variantAlleles)[k],
 									snpAllele
 								);
 							}
 							
-							variant->alleles[k] = snpAllele;
+							(*variantAlleles)[k] = snpAllele;
 						}
 					}
 				}
@@ -792,13 +1016,16 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 	{
 		for ( int j = 0; j < trackList->getTrackCount(); j++ )
 		{
-			if ( variants.at(i).alleles.at(j) == 0 )
+			if ( alleleRows.at(i).at(j) == 0 )
 			{
-				variants[i].alleles[j] = variants.at(i).reference;
+				alleleRows[i][j] = variants.at(i).reference;
 			}
 		}
+		
+		alleles.addRow(alleleRows[i].c_str(), alleleRows[i].length());
 	}
 	
+	vector<string>().swap(alleleRows);
 	sortVariants();
 	
 	if ( oldTags )
@@ -885,135 +1112,317 @@ void VariantList::initFromVcf(const char * file, const ReferenceList & reference
 	in.close();
 }
 
-void VariantList::sortVariants()
+void VariantList::setMemoryLimit(size_t bytes)
 {
-	sort(variants.begin(), variants.end(), variantLessThan);
+	memoryLimit = bytes;
 }
 
-void VariantList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
+void VariantList::setWindowFilters(int windowNew, double conservationMinNew, double gapMaxNew)
 {
-	capnp::Harvest::VariantList::Builder variantListBuilder = harvestBuilder.initVariantList();
+	window = windowNew;
+	conservationMin = conservationMinNew;
+	gapMax = gapMaxNew;
+}
+
+void VariantList::sortVariants()
+{
+	// Variants called from one alignment are already in order, so only the
+	// runs need to be merged. Variants that didn't come from alignments (or
+	// runs that turn out to be out of order) fall back to a full sort. Either
+	// way, indices are ordered rather than variants so the allele rows can
+	// follow.
 	
-	capnp::List<capnp::Harvest::VariantList::Filter>::Builder filtersBuilder = variantListBuilder.initFilters(filters.size());
+	vector<int> order;
+	vector<int> runEnds;
+	bool merge = true;
 	
-	for ( int i = 0; i < filters.size(); i++ )
+	if ( runStarts.size() == 0 || runStarts[0] != 0 )
 	{
-		capnp::Harvest::VariantList::Filter::Builder filterBuilder = filtersBuilder[i];
-		
-		filterBuilder.setFlag(filters[i].flag);
-		filterBuilder.setName(filters[i].name);
-		filterBuilder.setDescription(filters[i].description);
+		runStarts.insert(runStarts.begin(), 0);
 	}
 	
-	capnp::List<capnp::Harvest::VariantList::Variant>::Builder variantsBuilder = variantListBuilder.initVariants(variants.size());
-	
-	for ( int i = 0; i < variants.size(); i++ )
+	for ( int i = 0; i < runStarts.size(); i++ )
 	{
-		capnp::Harvest::VariantList::Variant::Builder variantBuilder = variantsBuilder[i];
+		int end = i + 1 < runStarts.size() ? runStarts[i + 1] : variants.size();
 		
-		const Variant & variant = variants[i % variants.size()];
+		if ( ! is_sorted(variants.begin() + runStarts[i], variants.begin() + end, variantLessThan) )
+		{
+			merge = false;
+		}
 		
-		variantBuilder.setSequence(variant.sequence);
-		variantBuilder.setReference(variant.reference);
-		variantBuilder.setPosition(variant.position);
-		variantBuilder.setAlleles(variant.alleles);
-		variantBuilder.setFilters(variant.filters);
+		runEnds.push_back(end);
 	}
-}
-
-void VariantList::writeToMfa(std::ostream &out, bool indels, const TrackList & trackList) const
-{
-	int wrap = 80;
-	int col;
 	
-	for ( int i = 0; i < trackList.getTrackCount(); i++ )
+	order.reserve(variants.size());
+	
+	if ( merge )
 	{
-		const TrackList::Track & track = trackList.getTrack(i);
+		// k-way merge on a heap of runs, keyed by each run's next variant
+		// (ties go to the earlier run)
 		
-		out << '>' << (track.file.length() ? track.file : track.name) << endl;
-		col = 0;
+		vector<int> next(runStarts);
 		
-		for ( int j = 0; j < variants.size(); j++ )
+		auto runGreater = [&](int a, int b)
 		{
-			if ( ! indels && variants.at(j).filters && variants.at(j).filters != FILTER_n )
+			const Variant & variantA = variants[next[a]];
+			const Variant & variantB = variants[next[b]];
+			
+			if ( variantLessThan(variantB, variantA) )
 			{
-				continue;
+				return true;
 			}
 			
-			col++;
-			
-			if ( wrap && col > wrap )
+			return ! variantLessThan(variantA, variantB) && a > b;
+		};
+		
+		vector<int> heap;
+		
+		for ( int i = 0; i < runStarts.size(); i++ )
+		{
+			if ( runStarts[i] < runEnds[i] )
 			{
-				out << endl;
-				col = 1;
+				heap.push_back(i);
 			}
+		}
+		
+		make_heap(heap.begin(), heap.end(), runGreater);
+		
+		while ( heap.size() )
+		{
+			pop_heap(heap.begin(), heap.end(), runGreater);
+			
+			int run = heap.back();
+			
+			order.push_back(next[run]);
+			next[run]++;
 			
-			out << variants.at(j).alleles[i];
+			if ( next[run] < runEnds[run] )
+			{
+				push_heap(heap.begin(), heap.end(), runGreater);
+			}
+			else
+			{
+				heap.pop_back();
+			}
+		}
+	}
+	else
+	{
+		for ( int i = 0; i < variants.size(); i++ )
+		{
+			order.push_back(i);
 		}
 		
-		out << endl;
+		sort(order.begin(), order.end(), [&](int a, int b) { return variantLessThan(variants[a], variants[b]); });
 	}
-}
-
-void VariantList::writeToProtocolBuffer(Harvest * msg) const
-{
-	Harvest::Variation * msgVar = msg->mutable_variation();
 	
-	for ( int i = 0; i < filters.size(); i++ )
+	runStarts.clear();
+	runStarts.push_back(0);
+	
+	bool identity = true;
+	
+	for ( int i = 0; i < order.size() && identity; i++ )
 	{
-		Harvest::Variation::Filter * msgFilter = msgVar->add_filters();
-		
-		msgFilter->set_flag(filters[i].flag);
-		msgFilter->set_name(filters[i].name);
-		msgFilter->set_description(filters[i].description);
+		identity = order[i] == i;
 	}
 	
-	for ( int i = 0; i < variants.size(); i++ )
+	if ( identity )
 	{
-		Harvest::Variation::Variant * variant = msgVar->add_variants();
-		
-		variant->set_sequence(variants[i].sequence);
-		variant->set_reference(variants[i].reference);
-		variant->set_position(variants[i].position);
-		variant->set_alleles(variants[i].alleles);
-		variant->set_filters(variants[i].filters);
+		return;
+	}
+	
+	vector<Variant> variantsSorted(variants.size());
+	
+	for ( int i = 0; i < order.size(); i++ )
+	{
+		variantsSorted[i] = variants[order[i]];
 	}
+	
+	variants.swap(variantsSorted);
+	alleles.permuteRows(order);
 }
 
-void VariantList::writeToVcf(std::ostream &out, bool indels, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const vector<int> & tracksFocus, bool signature) const
+void VariantList::writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const
 {
-	//tjt: Currently outputs SNPs, no indels
-	//tjt: next pass will add standard VCF output for indels, plus an attempt at qual vals
-	//tjt: also filters need to be added to findVariants to populate FILTer column
-	
-	int annCur = -1; // current annotation
-	int annNext = 0;
+	capnp::Harvest::VariantList::Builder variantListBuilder = harvestBuilder.initVariantList();
 	
-	//indel char, to skip columns with indels (for now)
-	char indl = '-';
-	//the VCF output file
-
-	out << "##INFO=<ID=CDS,Number=1,Type=String,Description=\"Coding sequence locus\">" << endl;
-	out << "##INFO=<ID=SYN,Number=0,Type=Flag,Description=\"All alternative alleles are synonymous in coding sequence\">" << endl;
-	out << "##INFO=<ID=AAR,Number=1,Type=String,Description=\"Reference amino acid in coding sequence\">" << endl;
-	out << "##INFO=<ID=AAA,Number=.,Type=String,Description=\"Alternate amino acid in coding sequence, one per alternate allele\">" << endl;
+	capnp::List<capnp::Harvest::VariantList::Filter>::Builder filtersBuilder = variantListBuilder.initFilters(filters.size());
 	
 	for ( int i = 0; i < filters.size(); i++ )
 	{
-		const Filter & filter = filters.at(i);
+		capnp::Harvest::VariantList::Filter::Builder filterBuilder = filtersBuilder[i];
 		
-		out << "##FILTER=<ID=" << filter.name << ",Description=\"" << filter.description << "\">\n";
+		filterBuilder.setFlag(filters[i].flag);
+		filterBuilder.setName(filters[i].name);
+		filterBuilder.setDescription(filters[i].description);
 	}
 	
-	//the VCF header line (skipping previous lines for simplicity, can/will add in later)
-	//#CHROM  POS     ID      REF     ALT     QUAL    FILTER  INFO    FORMAT  AA1 
-	out << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
-
-	vector<int> tracks;
+	capnp::List<capnp::Harvest::VariantList::Variant>::Builder variantsBuilder = variantListBuilder.initVariants(getVariantCountTotal());
+	int i = 0;
 	
-	if ( signature )
+	forEachVariant([&](const Variant & variant, const string & row)
 	{
-		// output all tracks
+		capnp::Harvest::VariantList::Variant::Builder variantBuilder = variantsBuilder[i++];
+		
+		variantBuilder.setSequence(variant.sequence);
+		variantBuilder.setReference(variant.reference);
+		variantBuilder.setPosition(variant.position);
+		variantBuilder.setAlleles(row);
+		variantBuilder.setFilters(variant.filters);
+	});
+}
+
+void VariantList::writeToMfa(std::ostream &stream, bool indels, const TrackList & trackList) const
+{
+	OutputSink out(stream);
+	
+	int wrap = 80;
+	int trackBlock = 64; // tracks to transpose at a time
+	vector<int> rows;
+	vector<string> columns;
+	
+	if ( spills.size() )
+	{
+		// Spilled variants can only be read in order, so make a pass over
+		// all of them for each block of tracks, keeping the block within
+		// the memory limit.
+		
+		size_t variantCount = getVariantCountTotal();
+		
+		trackBlock = max((size_t)1, min((size_t)trackBlock, memoryLimit / 3 / max(variantCount, (size_t)1)));
+	}
+	
+	for ( int j = 0; j < variants.size(); j++ )
+	{
+		if ( ! indels && variants.at(j).filters && variants.at(j).filters != FILTER_n )
+		{
+			continue;
+		}
+		
+		rows.push_back(j);
+	}
+	
+	// transpose a block of tracks at a time so each track's alleles can be
+	// written as contiguous runs
+	
+	for ( int first = 0; first < trackList.getTrackCount(); first += trackBlock )
+	{
+		int count = min(trackBlock, trackList.getTrackCount() - first);
+		
+		if ( spills.size() )
+		{
+			columns.resize(count);
+			
+			for ( int i = 0; i < count; i++ )
+			{
+				columns[i].clear();
+			}
+			
+			forEachVariant([&](const Variant & variant, const string & row)
+			{
+				if ( indels || ! variant.filters || variant.filters == FILTER_n )
+				{
+					for ( int i = 0; i < count; i++ )
+					{
+						columns[i].push_back(row[first + i]);
+					}
+				}
+			});
+		}
+		else
+		{
+			alleles.getColumns(first, count, rows, columns);
+		}
+		
+		for ( int i = 0; i < count; i++ )
+		{
+			const TrackList::Track & track = trackList.getTrack(first + i);
+			const string & column = columns[i];
+			
+			out << '>' << (track.file.length() ? track.file : track.name) << '\n';
+			
+			for ( int j = 0; j < column.length(); j += wrap )
+			{
+				if ( j > 0 )
+				{
+					out << '\n';
+				}
+				
+				out.write(column.data() + j, min(column.length() - j, (size_t)wrap));
+			}
+			
+			out << '\n';
+		}
+	}
+}
+
+void VariantList::writeToProtocolBuffer(Harvest * msg) const
+{
+	Harvest::Variation * msgVar = msg->mutable_variation();
+	
+	for ( int i = 0; i < filters.size(); i++ )
+	{
+		Harvest::Variation::Filter * msgFilter = msgVar->add_filters();
+		
+		msgFilter->set_flag(filters[i].flag);
+		msgFilter->set_name(filters[i].name);
+		msgFilter->set_description(filters[i].description);
+	}
+	
+	string row;
+	
+	for ( int i = 0; i < variants.size(); i++ )
+	{
+		Harvest::Variation::Variant * variant = msgVar->add_variants();
+		
+		variant->set_sequence(variants[i].sequence);
+		variant->set_reference(variants[i].reference);
+		variant->set_position(variants[i].position);
+		alleles.getRow(i, row);
+		variant->set_alleles(row);
+		variant->set_filters(variants[i].filters);
+	}
+}
+
+void VariantList::writeToVcf(std::ostream &stream, bool indels, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const vector<int> & tracksFocus, bool signature, int threads) const
+{
+	OutputSink out(stream);
+	
+	//tjt: Currently outputs SNPs, no indels
+	//tjt: next pass will add standard VCF output for indels, plus an attempt at qual vals
+	//tjt: also filters need to be added to findVariants to populate FILTer column
+	
+	vector<int> overlaps; // annotations at each variant
+	CodonIndex codonIndex;
+	
+	if ( annotationList.getAnnotationCount() )
+	{
+		codonIndex.init(annotationList, referenceList);
+	}
+	
+	//the VCF output file
+	
+	out << "##INFO=<ID=CDS,Number=1,Type=String,Description=\"Coding sequence locus\">" << '\n';
+	out << "##INFO=<ID=SYN,Number=0,Type=Flag,Description=\"All alternative alleles are synonymous in coding sequence\">" << '\n';
+	out << "##INFO=<ID=AAR,Number=1,Type=String,Description=\"Reference amino acid in coding sequence\">" << '\n';
+	out << "##INFO=<ID=AAA,Number=.,Type=String,Description=\"Alternate amino acid in coding sequence, one per alternate allele\">" << '\n';
+	
+	for ( int i = 0; i < filters.size(); i++ )
+	{
+		const Filter & filter = filters.at(i);
+		
+		out << "##FILTER=<ID=" << filter.name << ",Description=\"" << filter.description << "\">\n";
+	}
+	
+	//the VCF header line (skipping previous lines for simplicity, can/will add in later)
+	//#CHROM  POS     ID      REF     ALT     QUAL    FILTER  INFO    FORMAT  AA1 
+	out << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+	
+	vector<int> tracks;
+	
+	if ( signature )
+	{
+		// output all tracks
 		
 		for ( int i = 0; i < trackList.getTrackCount(); i++ )
 		{
@@ -1040,256 +1449,515 @@ void VariantList::writeToVcf(std::ostream &out, bool indels, const ReferenceList
 	
 	out << '\n';
 	
-	//now iterate over variants and output
-	for ( int j = 0; j < variants.size(); j++ )
+	if ( threads < 2 )
 	{
-		const Variant & variant = variants.at(j);
-
-		//no indels for now.. TODO: should this check outside the clade also?
-		bool indel = false;
-		//
-		for ( int i = 0; i < tracks.size(); i++ )
+		forEachVariant([&](const Variant & variant, const string & row)
 		{
-			if ( variant.alleles[tracks[i]] == indl )
+			writeVcfRecord(out, variant, row, referenceList, annotationList, trackList, tracks, tracksFocus, signature, codonIndex, overlaps);
+		});
+		
+		return;
+	}
+	
+	// Records are formatted in chunks on a thread pool, a batch of chunks at
+	// a time, and written in order.
+	
+	struct Chunk
+	{
+		vector<Variant> variants;
+		vector<string> rows;
+		int count;
+		vector<int> overlaps;
+		string text;
+	};
+	
+	ThreadPool threadPool(threads);
+	vector<Chunk> chunks(threadPool.getThreadCount() * 4);
+	int chunkSize = 1024;
+	int chunkCount = 0;
+	
+	for ( int i = 0; i < chunks.size(); i++ )
+	{
+		chunks[i].variants.resize(chunkSize);
+		chunks[i].rows.resize(chunkSize);
+		chunks[i].count = 0;
+	}
+	
+	auto writeChunks = [&]()
+	{
+		for ( int i = 0; i < chunkCount; i++ )
+		{
+			threadPool.run([&, i]()
 			{
-				indel = true;
-				break;
-			}
+				Chunk & chunk = chunks[i];
+				ostringstream text;
+				
+				{
+					OutputSink sink(text, 1 << 16);
+					
+					for ( int j = 0; j < chunk.count; j++ )
+					{
+						writeVcfRecord(sink, chunk.variants[j], chunk.rows[j], referenceList, annotationList, trackList, tracks, tracksFocus, signature, codonIndex, chunk.overlaps);
+					}
+				}
+				
+				chunk.text = text.str();
+			});
 		}
 		
-		if ( indel )
+		threadPool.wait();
+		
+		for ( int i = 0; i < chunkCount; i++ )
 		{
-			continue;
+			out << chunks[i].text;
+			chunks[i].count = 0;
 		}
 		
-		if ( tracks.size() != trackList.getTrackCount() )
+		chunkCount = 0;
+	};
+	
+	forEachVariant([&](const Variant & variant, const string & row)
+	{
+		if ( chunkCount == 0 || chunks[chunkCount - 1].count == chunkSize )
 		{
-			// differential
-			
-			bool same = true;
-			
-			for ( int i = 1; i < tracks.size(); i++ )
+			if ( chunkCount == chunks.size() )
 			{
-				if ( variant.alleles[tracks[i]] != variant.alleles[tracks[0]] )
-				{
-					same = false;
-					break;
-				}
+				writeChunks();
 			}
 			
-			if ( same )
-			{
-				continue;
-			}
+			chunkCount++;
 		}
-		else if ( signature )
+		
+		Chunk & chunk = chunks[chunkCount - 1];
+		
+		chunk.variants[chunk.count] = variant;
+		chunk.rows[chunk.count] = row;
+		chunk.count++;
+	});
+	
+	writeChunks();
+}
+
+void VariantList::addFilter(long long int flag, string name, string description)
+{
+	filters.resize(filters.size() + 1);
+	filters[filters.size() - 1].flag = flag;
+	filters[filters.size() - 1].name = name;
+	filters[filters.size() - 1].description = description;
+}
+
+void VariantList::closeSpills()
+{
+	for ( int i = 0; i < spills.size(); i++ )
+	{
+		::close(spills[i].fd);
+	}
+	
+	spills.clear();
+}
+
+void VariantList::forEachVariant(const function<void(const Variant &, const string &)> & visit) const
+{
+	string row;
+	
+	if ( spills.size() == 0 )
+	{
+		for ( int i = 0; i < variants.size(); i++ )
 		{
-			bool pass[tracks.size()];
-			
-			for ( int i = 0; i < tracks.size(); i++ )
-			{
-				pass[i] = variant.alleles[i] != variant.alleles[tracksFocus[0]];
-			}
-			
-			for ( int i = 0; i < tracksFocus.size(); i++ )
-			{
-				pass[tracksFocus[i]] = variant.alleles[tracksFocus[i]] == variant.alleles[tracksFocus[0]];
-			}
-			
-			bool isSignature = true;
-			
-			for ( int i = 0; i < tracks.size(); i++ )
-			{
-				if ( ! pass[i] )
-				{
-					isSignature = false;
-					break;
-				}
-			}
+			alleles.getRow(i, row);
+			visit(variants[i], row);
+		}
+		
+		return;
+	}
+	
+	// Merge the spilled runs with the variants still in memory (the last
+	// source), keeping each source's next variant in a heap. Ties go to the
+	// earlier source.
+	
+	int sourceCount = spills.size() + 1;
+	vector<SpillReader> readers;
+	vector<Variant> nextVariants(sourceCount);
+	vector<string> nextRows(sourceCount, string(spills[0].columnCount, 0));
+	vector<size_t> remaining(sourceCount);
+	
+	for ( int i = 0; i < spills.size(); i++ )
+	{
+		readers.push_back(SpillReader(spills[i].fd, spills[i].size));
+		remaining[i] = spills[i].count;
+	}
+	
+	remaining[spills.size()] = variants.size();
+	
+	auto readNext = [&](int source)
+	{
+		if ( remaining[source] == 0 )
+		{
+			return false;
+		}
+		
+		remaining[source]--;
+		
+		if ( source == spills.size() )
+		{
+			int index = variants.size() - remaining[source] - 1;
 			
-			if ( ! isSignature )
-			{
-				continue;
-			}
+			nextVariants[source] = variants[index];
+			alleles.getRow(index, nextRows[source]);
+		}
+		else
+		{
+			readers[source].read(nextVariants[source], nextRows[source]);
 		}
 		
-		//capture the reference position of variant
-		int pos = variant.position;
+		return true;
+	};
+	
+	auto sourceGreater = [&](int a, int b)
+	{
+		if ( variantLessThan(nextVariants[b], nextVariants[a]) )
+		{
+			return true;
+		}
 		
-		// annotations use concatenated coords; sum previous ref lengths to translate
-		//
-		int offset = 0;
-		//
-		for ( int i = 0; i < variant.sequence; i++ )
+		return ! variantLessThan(nextVariants[a], nextVariants[b]) && a > b;
+	};
+	
+	vector<int> heap;
+	
+	for ( int i = 0; i < sourceCount; i++ )
+	{
+		if ( readNext(i) )
 		{
-			offset += referenceList.getReference(i).sequence.length();
+			heap.push_back(i);
 		}
+	}
+	
+	make_heap(heap.begin(), heap.end(), sourceGreater);
+	
+	while ( heap.size() )
+	{
+		pop_heap(heap.begin(), heap.end(), sourceGreater);
+		
+		int source = heap.back();
+		
+		visit(nextVariants[source], nextRows[source]);
 		
-		while ( annNext < annotationList.getAnnotationCount() && annotationList.getAnnotation(annNext).start <= pos + offset )
+		if ( readNext(source) )
 		{
-			if ( annotationList.getAnnotation(annNext).feature == "CDS" )
+			push_heap(heap.begin(), heap.end(), sourceGreater);
+		}
+		else
+		{
+			heap.pop_back();
+		}
+	}
+}
+
+size_t VariantList::getVariantCountTotal() const
+{
+	size_t count = variants.size();
+	
+	for ( int i = 0; i < spills.size(); i++ )
+	{
+		count += spills[i].count;
+	}
+	
+	return count;
+}
+
+void VariantList::spill()
+{
+	// Sort what's in memory and write it out as a run. The file is unlinked
+	// right away, so it goes away with the process.
+	
+	sortVariants();
+	
+	const char * dir = getenv("TMPDIR");
+	string path = string(dir && *dir ? dir : "/tmp") + "/harvest-variants-XXXXXX";
+	int fd = mkstemp(&path[0]);
+	
+	if ( fd < 0 )
+	{
+		cerr << "ERROR: could not create temporary variant file in " << path.substr(0, path.rfind('/')) << " (" << strerror(errno) << ")\n";
+		exit(1);
+	}
+	
+	unlink(path.c_str());
+	
+	Spill spillNew;
+	Variant previous;
+	string row;
+	string buffer;
+	
+	spillNew.fd = fd;
+	spillNew.size = 0;
+	spillNew.count = variants.size();
+	spillNew.columnCount = alleles.getColumnCount();
+	previous.sequence = 0;
+	previous.position = 0;
+	
+	for ( int i = 0; i < variants.size(); i++ )
+	{
+		alleles.getRow(i, row);
+		encodeVariant(buffer, variants[i], previous, row);
+		previous = variants[i];
+		
+		if ( buffer.size() >= 1 << 20 || i == variants.size() - 1 )
+		{
+			if ( ! writeAll(fd, (const unsigned char *)buffer.data(), buffer.size()) )
 			{
-				annCur = annNext;
+				cerr << "ERROR: could not write temporary variant file (" << strerror(errno) << ")\n";
+				exit(1);
 			}
 			
-			annNext++;
+			spillNew.size += buffer.size();
+			buffer.clear();
 		}
+	}
+	
+	spills.push_back(spillNew);
+	
+	variants.clear();
+	alleles.clear();
+	runStarts.clear();
+}
+
+void VariantList::writeVcfRecord(OutputSink & out, const Variant & variant, const string & row, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const vector<int> & tracks, const vector<int> & tracksFocus, bool signature, const CodonIndex & codonIndex, vector<int> & overlaps) const
+{
+	//indel char, to skip columns with indels (for now)
+	char indl = '-';
+	
+	//no indels for now.. TODO: should this check outside the clade also?
+	bool indel = false;
+	//
+	for ( int i = 0; i < tracks.size(); i++ )
+	{
+		if ( row[tracks[i]] == indl )
+		{
+			indel = true;
+			break;
+		}
+	}
+	
+	if ( indel )
+	{
+		return;
+	}
+	
+	if ( tracks.size() != trackList.getTrackCount() )
+	{
+		// differential
 		
-		//output first few columns, including context (+/- 7bp for now)
-		int ws = 10;
-		int lend = pos-ws;
-		int rend = ws;
-		
-		const string & refseq = referenceList.getReference(variant.sequence).sequence;
+		bool same = true;
 		
-		if (lend < 0)
-			lend = 0;
-		if (pos+ws >= refseq.size())
-			rend = refseq.size()-pos;
-		if (pos+rend >= refseq.size())
-			rend = 0;
-			
-		out << referenceList.getReference(variant.sequence).name << "\t" << pos + 1 << "\t" << refseq.substr(lend,ws) << "." << refseq.substr(pos,rend);
-
-		//build non-redundant allele list from cur alleles
-		vector<char> allele_list;
-		//first allele is ref allele (0)
-		out << "\t" << variant.reference << "\t";
-		allele_list.push_back(variant.reference);
-		bool prev_var = false;
-		for ( int i = 0; i < tracks.size(); i++ )
+		for ( int i = 1; i < tracks.size(); i++ )
 		{
-			char allele = variant.alleles[tracks[i]];
-			
-			if (find(allele_list.begin(), allele_list.end(), allele) == allele_list.end())
+			if ( row[tracks[i]] != row[tracks[0]] )
 			{
-				if (allele == indl) 
-					continue; // should never happen
-					
-				//to know if we need to output a preceding comma
-				if (prev_var)
-					out << ",";
-				
-				out << allele;
-
-				allele_list.push_back(allele);
-				prev_var = true;
+				same = false;
+				break;
 			}
 		}
 		
-		//below values, punt for now, fill in with actual values later..
-		//QUAL
-		if ( variant.quality != 0 )
+		if ( same )
 		{
-			out << '\t' << variant.quality; // currently only exists if imported from VCF
+			return;
 		}
-		else
+	}
+	else if ( signature )
+	{
+		bool pass[tracks.size()];
+		
+		for ( int i = 0; i < tracks.size(); i++ )
 		{
-			out << "\t40";
+			pass[i] = row[i] != row[tracksFocus[0]];
 		}
-
-		//FILT
-		//
-		out << '\t';
-		int filterCount = 0;
-		//
-		for ( int i = 0; i < filters.size(); i++ )
+		
+		for ( int i = 0; i < tracksFocus.size(); i++ )
 		{
-			const Filter & filter = filters.at(i);
-			
-			if ( variant.filters & filter.flag )
+			pass[tracksFocus[i]] = row[tracksFocus[i]] == row[tracksFocus[0]];
+		}
+		
+		bool isSignature = true;
+		
+		for ( int i = 0; i < tracks.size(); i++ )
+		{
+			if ( ! pass[i] )
 			{
-				if ( filterCount > 0 )
-				{
-					out << ':';
-				}
-				
-				out << filter.name;
-				filterCount++;
+				isSignature = false;
+				break;
 			}
 		}
-		//
-		if ( filterCount == 0 )
+		
+		if ( ! isSignature )
 		{
-			out << "PASS";
+			return;
 		}
+	}
+	
+	//capture the reference position of variant
+	int pos = variant.position;
+	
+	// annotations use concatenated coords; translate by the reference's offset
+	//
+	int offset = referenceList.getConcatenatedPosition(variant.sequence, 0);
+	
+	// the most recently started CDS coding at the variant (not spanning it
+	// with an intron), if any
+	//
+	int annCur = -1;
+	unsigned short codonRef;
+	int frame;
+	//
+	annotationList.getAnnotationsOverlapping(pos + offset, pos + offset, overlaps);
+	//
+	for ( int i = overlaps.size() - 1; i >= 0; i-- )
+	{
+		if ( codonIndex.getCodon(overlaps[i], pos + offset, codonRef, frame) )
+		{
+			annCur = overlaps[i];
+			break;
+		}
+	}
+	
+	//output first few columns, including context (+/- 7bp for now)
+	int ws = 10;
+	int lend = pos-ws;
+	int rend = ws;
+	
+	const string & refseq = referenceList.getReference(variant.sequence).sequence;
+	
+	if (lend < 0)
+		lend = 0;
+	if (pos+ws >= refseq.size())
+		rend = refseq.size()-pos;
+	if (pos+rend >= refseq.size())
+		rend = 0;
 		
-		//INFO
-		//
-		out << '\t';
-		//
-		if ( annCur != -1 && annotationList.getAnnotation(annCur).end >= pos + offset )
+	out << referenceList.getReference(variant.sequence).name << "\t" << pos + 1 << "\t" << refseq.substr(lend,ws) << "." << refseq.substr(pos,rend);
+	
+	//build non-redundant allele list from cur alleles
+	vector<char> allele_list;
+	//first allele is ref allele (0)
+	out << "\t" << variant.reference << "\t";
+	allele_list.push_back(variant.reference);
+	bool prev_var = false;
+	for ( int i = 0; i < tracks.size(); i++ )
+	{
+		char allele = row[tracks[i]];
+		
+		if (find(allele_list.begin(), allele_list.end(), allele) == allele_list.end())
 		{
-			out << "CDS=" << annotationList.getAnnotation(annCur).locus << ';';
-			
-			string codonRef = refseq.substr(annotationList.getAnnotation(annCur).start - offset + (pos + offset - annotationList.getAnnotation(annCur).start) / 3 * 3, 3);
-			int codonPos = (pos + offset - annotationList.getAnnotation(annCur).start) % 3;
-			
-			bool rc = annotationList.getAnnotation(annCur).reverse;
-			
-			string aaRef = translations.count(codonRef) ? rc ? translationsRc.at(codonRef) : translations.at(codonRef) : ".";
-			out << "AAR=" << aaRef << ";AAA=";
+			if (allele == indl) 
+				continue; // should never happen
+				
+			//to know if we need to output a preceding comma
+			if (prev_var)
+				out << ",";
 			
-			bool syn = true;
+			out << allele;
 			
-			for ( int i = 1; i < allele_list.size(); i++ )
+			allele_list.push_back(allele);
+			prev_var = true;
+		}
+	}
+	
+	//below values, punt for now, fill in with actual values later..
+	//QUAL
+	if ( variant.quality != 0 )
+	{
+		out << '\t' << variant.quality; // currently only exists if imported from VCF
+	}
+	else
+	{
+		out << "\t40";
+	}
+	
+	//FILT
+	//
+	out << '\t';
+	int filterCount = 0;
+	//
+	for ( int i = 0; i < filters.size(); i++ )
+	{
+		const Filter & filter = filters.at(i);
+		
+		if ( variant.filters & filter.flag )
+		{
+			if ( filterCount > 0 )
 			{
-				if ( i > 1 )
-				{
-					out << ',';
-				}
-				
-				string codonAlt = codonRef;
-				codonAlt[codonPos] = allele_list.at(i);
-				string aaAlt = translations.count(codonAlt) ? rc ? translationsRc.at(codonAlt) : translations.at(codonAlt) : ".";
-				
-				if ( aaRef != aaAlt )
-				{
-					syn = false;
-				}
-				
-				out << aaAlt;
+				out << ':';
 			}
 			
-			if ( syn )
-			{
-				out << ";SYN";
-			}
-		}
-		else
-		{
-			out << "NA";
+			out << filter.name;
+			filterCount++;
 		}
+	}
+	//
+	if ( filterCount == 0 )
+	{
+		out << "PASS";
+	}
+	
+	//INFO
+	//
+	out << '\t';
+	//
+	if ( annCur != -1 )
+	{
+		out << "CDS=" << annotationList.getAnnotation(annCur).locus << ';';
 		
-		//FORMAT
-		out << "\tGT";
-
-		//catch last one for newline
-		int i = 0;
+		const Annotation & annotation = annotationList.getAnnotation(annCur);
+		char aaRef = CodonIndex::translate(codonRef, annotation.geneticCode);
+		out << "AAR=" << aaRef << ";AAA=";
 		
-		map<char, int> indexByAllele;
+		bool syn = true;
 		
-		for ( int i = 0; i < allele_list.size(); i++ )
+		for ( int i = 1; i < allele_list.size(); i++ )
 		{
-			indexByAllele[allele_list[i]] = i;
+			if ( i > 1 )
+			{
+				out << ',';
+			}
+			
+			char aaAlt = CodonIndex::translate(CodonIndex::getCodonAlt(codonRef, frame, allele_list.at(i), annotation.reverse), annotation.geneticCode);
+			
+			if ( aaRef != aaAlt )
+			{
+				syn = false;
+			}
+			
+			out << aaAlt;
 		}
 		
-		for (i = 0; i < tracks.size(); i++ )
+		if ( syn )
 		{
-			out << "\t" << indexByAllele[variant.alleles[tracks[i]]];
+			out << ";SYN";
 		}
-		
-		out << "\n";
-
 	}
-	//done! should be well-formated VCF (see above notes)
-	//out.close();
-}
-
-void VariantList::addFilter(long long int flag, string name, string description)
-{
-	filters.resize(filters.size() + 1);
-	filters[filters.size() - 1].flag = flag;
-	filters[filters.size() - 1].name = name;
-	filters[filters.size() - 1].description = description;
+	else
+	{
+		out << "NA";
+	}
+	
+	//FORMAT
+	out << "\tGT";
+	
+	//catch last one for newline
+	int i = 0;
+	
+	map<char, int> indexByAllele;
+	
+	for ( int i = 0; i < allele_list.size(); i++ )
+	{
+		indexByAllele[allele_list[i]] = i;
+	}
+	
+	for (i = 0; i < tracks.size(); i++ )
+	{
+		out << "\t" << indexByAllele[row[tracks[i]]];
+	}
+	
+	out << "\n";
 }
@@ -7,7 +7,9 @@
 #ifndef VariantList_h
 #define VariantList_h
 
+#include <functional>
 #include <vector>
+#include "harvest/AlleleMatrix.h"
 #include "harvest/capnp/harvest.capnp.h"
 #include "harvest/pb/harvest.pb.h"
 #include "harvest/LcbList.h"
@@ -15,149 +17,18 @@
 #include "harvest/ReferenceList.h"
 #include "harvest/TrackList.h"
 #include "harvest/AnnotationList.h"
+#include "harvest/CodonIndex.h"
+#include "harvest/OutputSink.h"
 
 typedef long long unsigned int uint64;
 
-static const std::map<std::string, std::string> translations =
-{
-	{"TTT", "F"},
-	{"TCT", "S"},
-	{"TAT", "Y"},
-	{"TGT", "C"},
-	{"TTC", "F"},
-	{"TCC", "S"},
-	{"TAC", "Y"},
-	{"TGC", "C"},
-	{"TTA", "L"},
-	{"TCA", "S"},
-	{"TAA", "*"},
-	{"TGA", "*"},
-	{"TTG", "L"},
-	{"TCG", "S"},
-	{"TAG", "*"},
-	{"TGG", "W"},
-	{"CTT", "L"},
-	{"CCT", "P"},
-	{"CAT", "H"},
-	{"CGT", "R"},
-	{"CTC", "L"},
-	{"CCC", "P"},
-	{"CAC", "H"},
-	{"CGC", "R"},
-	{"CTA", "L"},
-	{"CCA", "P"},
-	{"CAA", "Q"},
-	{"CGA", "R"},
-	{"CTG", "L"},
-	{"CCG", "P"},
-	{"CAG", "Q"},
-	{"CGG", "R"},
-	{"ATT", "I"},
-	{"ACT", "T"},
-	{"AAT", "N"},
-	{"AGT", "S"},
-	{"ATC", "I"},
-	{"ACC", "T"},
-	{"AAC", "N"},
-	{"AGC", "S"},
-	{"ATA", "I"},
-	{"ACA", "T"},
-	{"AAA", "K"},
-	{"AGA", "R"},
-	{"ATG", "M"},
-	{"ACG", "T"},
-	{"AAG", "K"},
-	{"AGG", "R"},
-	{"GTT", "V"},
-	{"GCT", "A"},
-	{"GAT", "D"},
-	{"GGT", "G"},
-	{"GTC", "V"},
-	{"GCC", "A"},
-	{"GAC", "D"},
-	{"GGC", "G"},
-	{"GTA", "V"},
-	{"GCA", "A"},
-	{"GAA", "E"},
-	{"GGA", "G"},
-	{"GTG", "V"},
-	{"GCG", "A"},
-	{"GAG", "E"},
-	{"GGG", "G"},
-};
-
-static const std::map<std::string, std::string> translationsRc =
-{
-	{"TTT", "K"},
-	{"GTT", "N"},
-	{"CTT", "K"},
-	{"ATT", "N"},
-	{"TGT", "T"},
-	{"GGT", "T"},
-	{"CGT", "T"},
-	{"AGT", "T"},
-	{"TCT", "R"},
-	{"GCT", "S"},
-	{"CCT", "R"},
-	{"ACT", "S"},
-	{"TAT", "I"},
-	{"GAT", "I"},
-	{"CAT", "M"},
-	{"AAT", "I"},
-	{"TTG", "Q"},
-	{"GTG", "H"},
-	{"CTG", "Q"},
-	{"ATG", "H"},
-	{"TGG", "P"},
-	{"GGG", "P"},
-	{"CGG", "P"},
-	{"AGG", "P"},
-	{"TCG", "R"},
-	{"GCG", "R"},
-	{"CCG", "R"},
-	{"ACG", "R"},
-	{"TAG", "L"},
-	{"GAG", "L"},
-	{"CAG", "L"},
-	{"AAG", "L"},
-	{"TTC", "E"},
-	{"GTC", "D"},
-	{"CTC", "E"},
-	{"ATC", "D"},
-	{"TGC", "A"},
-	{"GGC", "A"},
-	{"CGC", "A"},
-	{"AGC", "A"},
-	{"TCC", "G"},
-	{"GCC", "G"},
-	{"CCC", "G"},
-	{"ACC", "G"},
-	{"TAC", "V"},
-	{"GAC", "V"},
-	{"CAC", "V"},
-	{"AAC", "V"},
-	{"TTA", "*"},
-	{"GTA", "Y"},
-	{"CTA", "*"},
-	{"ATA", "Y"},
-	{"TGA", "S"},
-	{"GGA", "S"},
-	{"CGA", "S"},
-	{"AGA", "S"},
-	{"TCA", "*"},
-	{"GCA", "C"},
-	{"CCA", "W"},
-	{"ACA", "C"},
-	{"TAA", "L"},
-	{"GAA", "F"},
-	{"CAA", "L"},
-	{"AAA", "F"},
-};
-
 class VariantList
 {
 public:
 	
+	VariantList();
+	~VariantList();
+	
 	struct Filter
 	{
 		uint64 flag;
@@ -171,7 +42,6 @@ public:
 		int position;
 		int offset;
 		char reference;
-		std::string alleles;
 		long long int filters;
 		int quality;
 	};
@@ -222,20 +92,28 @@ public:
 	
 	void addFilterFromBed(const char * file, const char * name, const char * desc);
 	void addVariantsFromAlignment(const std::vector<std::string> & seqs, const ReferenceList & referenceList, int sequence, int position, int length, bool reverse = false);
+	void appendVariants(VariantList & other); // moves the other list's variants to the end of this one
 	void clear();
+	char getAllele(int variant, int track) const;
+	const AlleleMatrix & getAlleles() const;
+	double getConservationMin() const;
 	const Filter & getFilter(int index) const;
 	int getFilterCount() const;
+	int getFilterWindow() const;
+	double getGapMax() const;
 	const Variant & getVariant(int index) const;
 	int getVariantCount() const;
 	void init();
 	void initFromCapnp(const capnp::Harvest::Reader & harvestReader);
 	void initFromProtocolBuffer(const Harvest::Variation & msgVariation);
 	void initFromVcf(const char * file, const ReferenceList & referenceList, TrackList * trackList, LcbList * lcbList, PhylogenyTree * phylogenyTree);
-	void sortVariants();
+	void setMemoryLimit(size_t bytes); // spill sorted runs of variants to temporary files past this; 0 for none
+	void setWindowFilters(int windowNew, double conservationMinNew, double gapMaxNew); // call before init()
+	void sortVariants(); // merges the runs of variants called from each alignment
 	void writeToMfa(std::ostream &out, bool indels, const TrackList & trackList) const;
 	void writeToProtocolBuffer(Harvest * harvest) const;
 	void writeToCapnp(capnp::Harvest::Builder & harvestBuilder) const;
-	void writeToVcf(std::ostream &out, bool indels, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const std::vector<int> & tracks, bool signature = false) const;
+	void writeToVcf(std::ostream &out, bool indels, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const std::vector<int> & tracks, bool signature = false, int threads = 1) const; // formats records in parallel with more than one thread
 	
 	static bool variantLessThan(const Variant & a, const Variant & b)
 	{
@@ -267,14 +145,53 @@ private:
 		FILTER_gaps = 16,
 	};
 	
+	VariantList(const VariantList &);
+	VariantList & operator=(const VariantList &);
+	
 	void addFilter(long long int flag, std::string name, std::string description);
+	void closeSpills();
+	void forEachVariant(const std::function<void(const Variant &, const std::string &)> & visit) const; // in order, merging spilled runs
+	size_t getVariantCountTotal() const; // including spilled
+	void spill();
+	void writeVcfRecord(OutputSink & out, const Variant & variant, const std::string & row, const ReferenceList & referenceList, const AnnotationList & annotationList, const TrackList & trackList, const std::vector<int> & tracks, const std::vector<int> & tracksFocus, bool signature, const CodonIndex & codonIndex, std::vector<int> & overlaps) const;
 	
 	std::vector<Filter> filters;
 	std::vector<Variant> variants;
+	AlleleMatrix alleles; // rows correspond to variants
+	std::vector<int> runStarts; // variants called from each alignment, for sortVariants()
+	
+	// With a memory limit, variants appended past it are sorted and written
+	// to temporary files in a compact encoding. The VCF, SNP MFA and Cap'n
+	// Proto writers merge these runs with whatever is left in memory; other
+	// uses of the list only see what is in memory.
+	//
+	struct Spill
+	{
+		int fd;
+		size_t size; // bytes
+		size_t count; // variants
+		int columnCount; // alleles per variant
+	};
+	//
+	size_t memoryLimit;
+	std::vector<Spill> spills;
+	
+	// CID and ALN filter parameters: the window is centered on each SNP, and
+	// the thresholds are fractions of the window size.
+	//
+	int window;
+	double conservationMin;
+	double gapMax;
 };
 
+inline char VariantList::getAllele(int variant, int track) const { return alleles.getAllele(variant, track); }
+inline const AlleleMatrix & VariantList::getAlleles() const { return alleles; }
+
+inline double VariantList::getConservationMin() const { return conservationMin; }
 inline const VariantList::Filter & VariantList::getFilter(int index) const { return filters.at(index); }
 inline int VariantList::getFilterCount() const { return filters.size(); }
+inline int VariantList::getFilterWindow() const { return window; }
+inline double VariantList::getGapMax() const { return gapMax; }
 inline const VariantList::Variant & VariantList::getVariant(int index) const { return variants.at(index); }
 inline int VariantList::getVariantCount() const { return variants.size(); }
 
@@ -0,0 +1,112 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef codon_h
+#define codon_h
+
+// Codons are encoded in 6 bits, two per base with T=0, C=1, A=2, G=3 and the
+// first base most significant, which is the order NCBI lists its genetic
+// codes in. The complement of a base code is then the code xor 2.
+
+static const int codonUndef = -1;
+static const int geneticCodeStandard = 1;
+static const int geneticCodeCount = 34; // highest /transl_table id + 1
+
+// Amino acids for each codon, by NCBI /transl_table id; ids that are not
+// assigned are null.
+//
+static constexpr const char * geneticCodes[geneticCodeCount] =
+{
+	0,
+	"FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 1 standard
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSS**VVVVAAAADDEEGGGG", // 2 vertebrate mitochondrial
+	"FFLLSSSSYY**CCWWTTTTPPPPHHQQRRRRIIMMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 3 yeast mitochondrial
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 4 mold, protozoan, coelenterate mitochondrial; mycoplasma
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSSSVVVVAAAADDEEGGGG", // 5 invertebrate mitochondrial
+	"FFLLSSSSYYQQCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 6 ciliate, dasycladacean, hexamita nuclear
+	0,
+	0,
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG", // 9 echinoderm, flatworm mitochondrial
+	"FFLLSSSSYY**CCCWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 10 euplotid nuclear
+	"FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 11 bacterial, archaeal, plant plastid
+	"FFLLSSSSYY**CC*WLLLSPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 12 alternative yeast nuclear
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSGGVVVVAAAADDEEGGGG", // 13 ascidian mitochondrial
+	"FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG", // 14 alternative flatworm mitochondrial
+	"FFLLSSSSYY*QCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 15 blepharisma nuclear
+	"FFLLSSSSYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 16 chlorophycean mitochondrial
+	0,
+	0,
+	0,
+	0,
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNNKSSSSVVVVAAAADDEEGGGG", // 21 trematode mitochondrial
+	"FFLLSS*SYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 22 scenedesmus obliquus mitochondrial
+	"FF*LSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 23 thraustochytrium mitochondrial
+	"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG", // 24 rhabdopleuridae mitochondrial
+	"FFLLSSSSYY**CCGWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 25 candidate division SR1, gracilibacteria
+	"FFLLSSSSYY**CC*WLLLAPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 26 pachysolen tannophilus nuclear
+	"FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 27 karyorelict nuclear
+	"FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 28 condylostoma nuclear
+	"FFLLSSSSYYYYCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 29 mesodinium nuclear
+	"FFLLSSSSYYEECC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 30 peritrich nuclear
+	"FFLLSSSSYYEECCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG", // 31 blastocrithidia nuclear
+	0,
+	"FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG", // 33 cephalodiscidae mitochondrial
+};
+
+// Base code of an (uppercase) nucleotide, or codonUndef for anything else
+//
+constexpr int getBaseCode(char base)
+{
+	return
+		base == 'T' ? 0 :
+		base == 'C' ? 1 :
+		base == 'A' ? 2 :
+		base == 'G' ? 3 :
+		codonUndef;
+}
+
+// Codon code of three bases, or codonUndef if any is not an uppercase
+// nucleotide
+//
+constexpr int getCodonCode(char first, char second, char third)
+{
+	return
+		getBaseCode(first) == codonUndef ||
+		getBaseCode(second) == codonUndef ||
+		getBaseCode(third) == codonUndef ?
+		codonUndef :
+		getBaseCode(first) << 4 | getBaseCode(second) << 2 | getBaseCode(third);
+}
+
+// Code of the reverse complement of a codon
+//
+constexpr int getCodonCodeRc(int codon)
+{
+	return ((codon & 3) ^ 2) << 4 | ((codon & 12) ^ 8) | ((codon >> 4) ^ 2);
+}
+
+// Amino acid for a codon in the given genetic code, read on the reverse
+// strand if specified. Unassigned codes are treated as the standard code, and
+// undefined codons translate to '.'.
+//
+constexpr char translateCodon(int codon, bool reverse = false, int geneticCode = geneticCodeStandard)
+{
+	return
+		codon == codonUndef ? '.' :
+		geneticCodes
+		[
+			geneticCode > 0 && geneticCode < geneticCodeCount && geneticCodes[geneticCode] ?
+			geneticCode :
+			geneticCodeStandard
+		]
+		[reverse ? getCodonCodeRc(codon) : codon];
+}
+
+static_assert(translateCodon(getCodonCode('A', 'T', 'G')) == 'M', "codon encoding");
+static_assert(translateCodon(getCodonCode('C', 'A', 'T'), true) == 'M', "reverse complement codon encoding");
+static_assert(translateCodon(getCodonCode('T', 'G', 'A'), false, 2) == 'W', "genetic code selection");
+
+#endif
@@ -6,7 +6,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <algorithm>
 #include "harvest/HarvestIO.h"
+#include "harvest/ThreadPool.h"
 #include <string.h>
 #include "harvest/exceptions.h"
 
@@ -54,6 +57,24 @@ void parseTracks(char * arg, vector<string> & tracks, bool & lca)
 	}
 }
 
+void runWriter(ThreadPool & threadPool, const char * file, const function<void(ostream &)> & writer)
+{
+	// writers to stdout run immediately, in order, so their output is not
+	// interleaved; writers to files are queued on the pool
+	
+	if ( strcmp(file, "-") == 0 )
+	{
+		writer(cout);
+		return;
+	}
+	
+	threadPool.run([=]()
+	{
+		ofstream out(file);
+		writer(out);
+	});
+}
+
 static const char * version = "1.3";
 
 int main(int argc, char * argv[])
@@ -85,6 +106,12 @@ int main(int argc, char * argv[])
 	bool clearMult = false;
 	bool quiet = false;
 	bool midpointReroot = false;
+	int threads = 1;
+	bool uncompressed = false;
+	int filterWindow = 100;
+	double filterCid = 0.5;
+	double filterAln = 0.2;
+	int maxMemory = 0;
 	
 	//stdout flag
 	string out1("-");
@@ -105,6 +132,48 @@ int main(int argc, char * argv[])
 					{
 						midpointReroot = true;
 					}
+					else if ( strcmp(argv[i], "--threads") == 0 )
+					{
+						threads = atoi(argv[++i]);
+						
+						if ( threads < 1 )
+						{
+							printf("ERROR: --threads must be at least 1.\n");
+							help = true;
+						}
+					}
+					else if ( strcmp(argv[i], "--filter-window") == 0 )
+					{
+						filterWindow = atoi(argv[++i]);
+						
+						if ( filterWindow < 2 )
+						{
+							printf("ERROR: --filter-window must be at least 2.\n");
+							help = true;
+						}
+					}
+					else if ( strcmp(argv[i], "--filter-cid") == 0 )
+					{
+						filterCid = atof(argv[++i]);
+					}
+					else if ( strcmp(argv[i], "--filter-aln") == 0 )
+					{
+						filterAln = atof(argv[++i]);
+					}
+					else if ( strcmp(argv[i], "--max-memory") == 0 )
+					{
+						maxMemory = atoi(argv[++i]);
+						
+						if ( maxMemory < 1 )
+						{
+							printf("ERROR: --max-memory must be at least 1.\n");
+							help = true;
+						}
+					}
+					else if ( strcmp(argv[i], "--uncompressed") == 0 )
+					{
+						uncompressed = true;
+					}
 					else if ( strcmp(argv[i], "--internal") == 0 )
 					{
 						parseTracks(argv[++i], tracks, lca);
@@ -176,6 +245,8 @@ int main(int argc, char * argv[])
 		cout << "   -N <Newick tree output>" << endl;
 		cout << "   --midpoint-reroot (reroot the tree at its midpoint after loading)" << endl;
 		cout << "   -o <Gingr output>" << endl;
+		cout << "     --uncompressed (write Gingr output uncompressed for fast, memory-mapped" << endl;
+		cout << "                     loading)" << endl;
 		cout << "   -S <output for multi-fasta SNPs>" << endl;
 		cout << "   -u 0/1 (update the branch values to reflect genome length)" << endl;
 		cout << "   -v <VCF input>" << endl;
@@ -188,18 +259,105 @@ int main(int argc, char * argv[])
 		cout << "     --signature <track1>:<track2>     #only signature variants of LCA clade of" << endl;
 		cout << "                                        <track1> and <track2>" << endl;
 		cout << "   -x <xmfa alignment file>" << endl;
+		cout << "     --filter-window <bp> (window around SNPs for CID and ALN filters when" << endl;
+		cout << "                           calling variants; default 100)" << endl;
+		cout << "     --filter-cid <fraction> (CID filters SNPs in windows with less column" << endl;
+		cout << "                              conservation; default 0.5)" << endl;
+		cout << "     --filter-aln <fraction> (ALN filters SNPs in windows with more gapped" << endl;
+		cout << "                              columns; default 0.2)" << endl;
 		cout << "   -X <output xmfa alignment file>" << endl;
 		cout << "   -h (show this help)" << endl;
 		cout << "   -q (quiet mode)" << endl;
+		cout << "   --threads <n> (number of threads to use; default 1)" << endl;
+		cout << "   --max-memory <MB> (approximate limit for variants held in memory when" << endl;
+		cout << "                      calling them from alignments; the rest are sorted in" << endl;
+		cout << "                      temporary files under $TMPDIR or /tmp)" << endl;
 		exit(0);
 	}
 	
 	HarvestIO hio;
 	
+	hio.setThreads(threads);
+	hio.variantList.setWindowFilters(filterWindow, filterCid, filterAln);
+	
+	if ( maxMemory )
+	{
+		// spilled variants can only be read back by the Gingr, SNP and VCF
+		// writers
+		
+		if ( outMfa || outMfaFiltered || outXmfa || bed.size() || updateBranchVals )
+		{
+			printf("ERROR: --max-memory cannot be used with -M, -I, -X, -b or -u.\n");
+			return 1;
+		}
+		
+		hio.variantList.setMemoryLimit((size_t)maxMemory << 20);
+	}
+	
 	if ( input )
 	{
+		// only load the sections of the archive the requested outputs use,
+		// unless it will be combined with other inputs or rewritten
+		
+		int sections = 0;
+		
+		if ( output || mfa || fasta || maf || genbank.size() || xmfa || newick || vcf || bed.size() )
+		{
+			sections = HarvestIO::SECTION_all;
+		}
+		
+		if ( outFasta )
+		{
+			sections |= HarvestIO::SECTION_references;
+		}
+		
+		if ( outMfa || outMfaFiltered || outXmfa )
+		{
+			sections |= HarvestIO::SECTION_references | HarvestIO::SECTION_tracks | HarvestIO::SECTION_lcbs | HarvestIO::SECTION_variants;
+		}
+		
+		if ( outNewick )
+		{
+			sections |= HarvestIO::SECTION_tracks | HarvestIO::SECTION_tree;
+		}
+		
+		if ( outSnp )
+		{
+			sections |= HarvestIO::SECTION_tracks | HarvestIO::SECTION_variants;
+		}
+		
+		if ( outBB )
+		{
+			sections |= HarvestIO::SECTION_tracks | HarvestIO::SECTION_lcbs;
+		}
+		
+		if ( outVcf )
+		{
+			sections |= HarvestIO::SECTION_references | HarvestIO::SECTION_annotations | HarvestIO::SECTION_tracks | HarvestIO::SECTION_variants;
+			
+			if ( lca )
+			{
+				sections |= HarvestIO::SECTION_tree;
+			}
+		}
+		
+		if ( updateBranchVals )
+		{
+			sections |= HarvestIO::SECTION_tree | HarvestIO::SECTION_lcbs | HarvestIO::SECTION_variants;
+		}
+		
+		if ( midpointReroot )
+		{
+			sections |= HarvestIO::SECTION_tree | HarvestIO::SECTION_tracks;
+		}
+		
 		if ( ! quiet ) cerr << "Loading " << input << "..." << endl;
-		hio.loadHarvest(input);
+		
+		if ( ! hio.loadHarvest(input, sections) )
+		{
+			cerr << "   ERROR: could not load " << input << '.' << endl;
+			return 1;
+		}
 	}
 	
 	if ( mfa )
@@ -248,7 +406,11 @@ int main(int argc, char * argv[])
 		for ( int i = 0; i < genbank.size(); i++ )
 		{
 			if ( ! quiet ) cerr << "Loading " << genbank[i] << "..." << endl;
-			hio.loadGenbank(genbank[i], useSeq);
+		}
+		
+		if ( genbank.size() )
+		{
+			hio.loadGenbank(genbank, useSeq);
 		}
 	}
 	catch ( const AnnotationList::NoSequenceException & e )
@@ -269,8 +431,16 @@ int main(int argc, char * argv[])
 	
 	if ( xmfa )
 	{
-		if ( ! quiet ) cerr << "Loading " << xmfa << "..." << endl;
-		hio.loadXmfa(xmfa, vcf == 0);
+		try
+		{
+			if ( ! quiet ) cerr << "Loading " << xmfa << "..." << endl;
+			hio.loadXmfa(xmfa, vcf == 0);
+		}
+		catch ( const BadInputFileException & )
+		{
+			cerr << "   ERROR: could not open " << xmfa << " for reading." << endl;
+			return 1;
+		}
 	}
 	
 	if ( newick )
@@ -334,7 +504,7 @@ int main(int argc, char * argv[])
 		delete [] arg;
 	}
 	
-	if ( midpointReroot )
+	if ( midpointReroot && hio.phylogenyTree.getRoot() )
 	{
 		hio.phylogenyTree.midpointReroot();
 	}
@@ -360,169 +530,175 @@ int main(int argc, char * argv[])
 		hio.phylogenyTree.setMult(1.0);
 	}
 	
+	// Writers only read from hio, so those writing to files run concurrently,
+	// each with its own stream. Checks that can fail are done up front.
+	//
+	// The Harvest and VCF writers also use threads of their own; they split
+	// what the other writers leave of the thread budget, so the total stays
+	// within --threads.
+	
+	int writers = (output != 0) + (outFasta != 0) + (outMfa != 0) + (outMfaFiltered != 0) + (outNewick != 0) + (outSnp != 0) + (outBB != 0) + (outXmfa != 0) + (outVcf != 0);
+	int writersThreaded = (output != 0) + (outVcf != 0);
+	
+	if ( writersThreaded && threads > writers )
+	{
+		hio.setThreads((threads - (writers - writersThreaded)) / writersThreaded);
+	}
+	else
+	{
+		hio.setThreads(1);
+	}
+	
+	ThreadPool threadPool(min(threads, max(writers, 1)));
+	
+	if ( outNewick && ! hio.phylogenyTree.getRoot() )
+	{
+		printf("Cannot write Newick; no tree loaded.\n");
+		return 1;
+	}
+	
+	const PhylogenyTreeNode * lcaNode = 0;
+	
+	if ( outVcf )
+	{
+		if ( lca && ! hio.phylogenyTree.getRoot() )
+		{
+			cerr << "ERROR: No tree loaded for LCA\n";
+			return 1;
+		}
+		
+		try
+		{
+			for ( int i = 0; i < tracks.size(); i++ )
+			{
+				hio.trackList.getTrackIndexByFile(tracks[i]);
+			}
+			
+			if ( lca )
+			{
+				lcaNode = hio.phylogenyTree.getLca
+				(
+					hio.trackList.getTrackIndexByFile(tracks[0]),
+					hio.trackList.getTrackIndexByFile(tracks[1])
+				);
+			}
+		}
+		catch ( const TrackList::TrackNotFoundException & e )
+		{
+			cerr << "ERROR: No track named \"" << e.name << "\"" << endl;
+			return 1;
+		}
+	}
+	
 	if ( output )
 	{
 		if (!quiet) cerr << "Writing " << output << "...\n";
-		hio.writeHarvest(output);
+		
+		threadPool.run([&]()
+		{
+			hio.writeHarvest(output, ! uncompressed);
+		});
 	}
 	
 	if ( outFasta )
 	{
 		if (!quiet) cerr << "Writing " << outFasta << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outFasta) != 0) 
+		runWriter(threadPool, outFasta, [&](ostream & out)
 		{
-			fout.open(outFasta);
-			fp = &fout;
-		}
-		
-		hio.writeFasta(*fp);
+			hio.writeFasta(out);
+		});
 	}
 	
 	if ( outMfa )
 	{
 		if (!quiet) cerr << "Writing " << outMfa << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outMfa) != 0) 
+		runWriter(threadPool, outMfa, [&](ostream & out)
 		{
-			fout.open(outMfa);
-			fp = &fout;
-		}
-		
-		hio.writeMfa(*fp);
+			hio.writeMfa(out);
+		});
 	}
 
 	if ( outMfaFiltered )
 	{
 	  if (!quiet) cerr << "Writing " << outMfaFiltered << " and " << outMfaFilteredPositions << " ...\n";
 		
-		std::ostream* fp = &cout;
-		std::ostream* fp2 = &cout;
-		std::ofstream fout;
-		std::ofstream fout2;
-		
 		if (out1.compare(outMfaFiltered) != 0) 
 		{
-
-			fout.open(outMfaFiltered);
-			fout2.open(outMfaFilteredPositions);
-			fp = &fout;
-			fp2 = &fout2;
+			threadPool.run([&]()
+			{
+				std::ofstream fout(outMfaFiltered);
+				std::ofstream fout2(outMfaFilteredPositions);
+				
+				hio.writeFilteredMfa(fout, fout2);
+			});
+		}
+		else
+		{
+			hio.writeFilteredMfa(cout, cout);
 		}
-		
-		hio.writeFilteredMfa(*fp, *fp2);
 	}
 
 	if ( outNewick )
 	{
 		if (!quiet) cerr << "Writing " << outNewick << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outNewick) != 0) 
+		runWriter(threadPool, outNewick, [&](ostream & out)
 		{
-			fout.open(outNewick);
-			fp = &fout;
-		}
-		hio.writeNewick(*fp, true);
+			hio.writeNewick(out, true);
+		});
 	}
 	
 	if ( outSnp )
 	{
 		if (!quiet) cerr << "Writing " << outSnp << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outSnp) != 0) 
+		runWriter(threadPool, outSnp, [&](ostream & out)
 		{
-			fout.open(outSnp);
-			fp = &fout;
-		}
-		
-		hio.writeSnp(*fp, false);
+			hio.writeSnp(out, false);
+		});
 	}
 
 	if ( outBB )
 	{
 		if (!quiet) cerr << "Writing " << outBB << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outBB) != 0) 
+		runWriter(threadPool, outBB, [&](ostream & out)
 		{
-			fout.open(outBB);
-			fp = &fout;
-		}
-		
-		hio.writeBackbone(*fp);
+			hio.writeBackbone(out);
+		});
 	}
 	
 	if ( outXmfa )
 	{
 		if (!quiet) cerr << "Writing " << outXmfa << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outXmfa) != 0) 
+		runWriter(threadPool, outXmfa, [&](ostream & out)
 		{
-			fout.open(outXmfa);
-			fp = &fout;
-		}
-		
-		hio.writeXmfa(*fp);
+			hio.writeXmfa(out);
+		});
 	}
 
 	if ( outVcf )
 	{
-		if ( lca && ! hio.phylogenyTree.getRoot() )
-		{
-			cerr << "ERROR: No tree loaded for LCA\n";
-			return 1;
-		}
-		
 		if (!quiet) cerr << "Writing " << outVcf << "...\n";
 		
-		std::ostream* fp = &cout;
-		std::ofstream fout;
-		
-		if (out1.compare(outVcf) != 0) 
-		{
-			fout.open(outVcf);
-			fp = &fout;
-		}
-		
-		try
+		runWriter(threadPool, outVcf, [&](ostream & out)
 		{
 			hio.writeVcf
 			(
-				*fp,
+				out,
 				tracks.size() > 0 && ! lca ? &tracks : 0,
-				lca ? hio.phylogenyTree.getLca
-				(
-					hio.trackList.getTrackIndexByFile(tracks[0]),
-					hio.trackList.getTrackIndexByFile(tracks[1])
-				) : 0,
+				lcaNode,
 				true,
 				signature
 			);
-		}
-		catch ( const TrackList::TrackNotFoundException & e )
-		{
-			cerr << "ERROR: No track named \"" << e.name << "\"" << endl;
-			return 1;
-		}
+		});
 	}
 	
+	threadPool.wait();
+	
     return 0;
 }
 
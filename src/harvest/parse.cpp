@@ -5,6 +5,8 @@
 // See the LICENSE.txt file included with this software for license information.
 
 #include "parse.h"
+#include <charconv>
+#include <ctype.h>
 #include <string.h>
 
 using namespace::std;
@@ -21,6 +23,34 @@ char complement(char base)
 	}
 }
 
+bool nextLine(const char *& data, const char * end, string_view & line)
+{
+	if ( data >= end )
+	{
+		return false;
+	}
+	
+	const char * newline = (const char *)memchr(data, '\n', end - data);
+	const char * lineEnd = newline ? newline : end;
+	
+	line = string_view(data, lineEnd - data);
+	data = newline ? newline + 1 : end;
+	
+	return true;
+}
+
+int parseInt(string_view token)
+{
+	int value = 0;
+	
+	if ( from_chars(token.data(), token.data() + token.size(), value).ec != errc() )
+	{
+		return 0;
+	}
+	
+	return value;
+}
+
 char * removePrefix(char * string, const char * substring)
 {
 	size_t len = strlen(substring);
@@ -45,6 +75,39 @@ void reverseComplement(string & sequence)
 	}
 }
 
+string_view splitPrefix(string_view & text, char delimiter)
+{
+	size_t end = text.find(delimiter);
+	string_view prefix = text.substr(0, end);
+	
+	text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+	
+	return prefix;
+}
+
+string_view splitToken(string_view & text)
+{
+	size_t start = 0;
+	
+	while ( start < text.size() && isspace((unsigned char)text[start]) )
+	{
+		start++;
+	}
+	
+	size_t end = start;
+	
+	while ( end < text.size() && ! isspace((unsigned char)text[end]) )
+	{
+		end++;
+	}
+	
+	string_view token = text.substr(start, end - start);
+	
+	text.remove_prefix(end);
+	
+	return token;
+}
+
 void ungap(string & gapped)
 {
 	int pos = 0;
@@ -8,10 +8,15 @@
 #define parse_h
 
 #include <string>
+#include <string_view>
 
 char complement(char base);
+bool nextLine(const char *& data, const char * end, std::string_view & line); // advances past the line and its newline; false at the end
+int parseInt(std::string_view token); // 0 if not a number
 char * removePrefix(char * string, const char * substring);
 void reverseComplement(std::string & sequence);
+std::string_view splitPrefix(std::string_view & text, char delimiter); // up to the delimiter, which is consumed
+std::string_view splitToken(std::string_view & text); // next whitespace-delimited token
 void ungap(std::string & gapped);
 
 #endif
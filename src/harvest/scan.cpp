@@ -0,0 +1,263 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+using namespace::std;
+
+// Nucleotide classes are accumulated as bits (A, C, G, T, gap) so that a
+// column is conserved if at most one bit is set.
+
+static inline unsigned char columnFlags(unsigned char variant, unsigned char gap, unsigned char n, unsigned char classes)
+{
+	unsigned char flags = 0;
+	
+	if ( variant )
+	{
+		flags |= COLUMN_variant;
+	}
+	
+	if ( gap )
+	{
+		flags |= COLUMN_gap;
+	}
+	
+	if ( n )
+	{
+		flags |= COLUMN_n;
+	}
+	
+	if ( (classes & (classes - 1)) == 0 )
+	{
+		flags |= COLUMN_conserved;
+	}
+	
+	return flags;
+}
+
+static void scanColumnsScalar(const vector<const char *> & rows, int first, int last, unsigned char * flags)
+{
+	for ( int i = first; i < last; i++ )
+	{
+		char ref = rows[0][i];
+		unsigned char variant = 0;
+		unsigned char gap = 0;
+		unsigned char n = 0;
+		unsigned char classes = 0;
+		
+		for ( int j = 0; j < rows.size(); j++ )
+		{
+			char c = rows[j][i];
+			char lower = c | 0x20;
+			
+			if ( c == '-' )
+			{
+				gap = 1;
+				classes |= 16;
+			}
+			else if ( lower == 'a' )
+			{
+				classes |= 1;
+			}
+			else if ( lower == 'c' )
+			{
+				classes |= 2;
+			}
+			else if ( lower == 'g' )
+			{
+				classes |= 4;
+			}
+			else if ( lower == 't' )
+			{
+				classes |= 8;
+			}
+			else if ( lower == 'n' && j > 0 )
+			{
+				n = 1;
+			}
+			
+			if ( c != ref )
+			{
+				variant = 1;
+			}
+		}
+		
+		flags[i] = columnFlags(variant, gap, n, classes);
+	}
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+static int scanColumnsSse2(const vector<const char *> & rows, int length, unsigned char * flags)
+{
+	const __m128i dash = _mm_set1_epi8('-');
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	const __m128i a = _mm_set1_epi8('a');
+	const __m128i c = _mm_set1_epi8('c');
+	const __m128i g = _mm_set1_epi8('g');
+	const __m128i t = _mm_set1_epi8('t');
+	const __m128i nn = _mm_set1_epi8('n');
+	const __m128i bitA = _mm_set1_epi8(1);
+	const __m128i bitC = _mm_set1_epi8(2);
+	const __m128i bitG = _mm_set1_epi8(4);
+	const __m128i bitT = _mm_set1_epi8(8);
+	const __m128i bitGap = _mm_set1_epi8(16);
+	
+	int i;
+	
+	for ( i = 0; i + 16 <= length; i += 16 )
+	{
+		__m128i ref = _mm_loadu_si128((const __m128i *)(rows[0] + i));
+		__m128i same = _mm_set1_epi8(-1);
+		__m128i gap = _mm_setzero_si128();
+		__m128i n = _mm_setzero_si128();
+		__m128i classes = _mm_setzero_si128();
+		
+		for ( int j = 0; j < rows.size(); j++ )
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(rows[j] + i));
+			__m128i lower = _mm_or_si128(x, caseBit);
+			__m128i isGap = _mm_cmpeq_epi8(x, dash);
+			
+			gap = _mm_or_si128(gap, isGap);
+			same = _mm_and_si128(same, _mm_cmpeq_epi8(x, ref));
+			
+			if ( j > 0 )
+			{
+				n = _mm_or_si128(n, _mm_cmpeq_epi8(lower, nn));
+			}
+			
+			classes = _mm_or_si128(classes, _mm_and_si128(_mm_cmpeq_epi8(lower, a), bitA));
+			classes = _mm_or_si128(classes, _mm_and_si128(_mm_cmpeq_epi8(lower, c), bitC));
+			classes = _mm_or_si128(classes, _mm_and_si128(_mm_cmpeq_epi8(lower, g), bitG));
+			classes = _mm_or_si128(classes, _mm_and_si128(_mm_cmpeq_epi8(lower, t), bitT));
+			classes = _mm_or_si128(classes, _mm_and_si128(isGap, bitGap));
+		}
+		
+		unsigned char sameBytes[16];
+		unsigned char gapBytes[16];
+		unsigned char nBytes[16];
+		unsigned char classBytes[16];
+		
+		_mm_storeu_si128((__m128i *)sameBytes, same);
+		_mm_storeu_si128((__m128i *)gapBytes, gap);
+		_mm_storeu_si128((__m128i *)nBytes, n);
+		_mm_storeu_si128((__m128i *)classBytes, classes);
+		
+		for ( int k = 0; k < 16; k++ )
+		{
+			flags[i + k] = columnFlags(! sameBytes[k], gapBytes[k], nBytes[k], classBytes[k]);
+		}
+	}
+	
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int scanColumnsAvx2(const vector<const char *> & rows, int length, unsigned char * flags)
+{
+	const __m256i dash = _mm256_set1_epi8('-');
+	const __m256i caseBit = _mm256_set1_epi8(0x20);
+	const __m256i a = _mm256_set1_epi8('a');
+	const __m256i c = _mm256_set1_epi8('c');
+	const __m256i g = _mm256_set1_epi8('g');
+	const __m256i t = _mm256_set1_epi8('t');
+	const __m256i nn = _mm256_set1_epi8('n');
+	const __m256i bitA = _mm256_set1_epi8(1);
+	const __m256i bitC = _mm256_set1_epi8(2);
+	const __m256i bitG = _mm256_set1_epi8(4);
+	const __m256i bitT = _mm256_set1_epi8(8);
+	const __m256i bitGap = _mm256_set1_epi8(16);
+	
+	int i;
+	
+	for ( i = 0; i + 32 <= length; i += 32 )
+	{
+		__m256i ref = _mm256_loadu_si256((const __m256i *)(rows[0] + i));
+		__m256i same = _mm256_set1_epi8(-1);
+		__m256i gap = _mm256_setzero_si256();
+		__m256i n = _mm256_setzero_si256();
+		__m256i classes = _mm256_setzero_si256();
+		
+		for ( int j = 0; j < rows.size(); j++ )
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)(rows[j] + i));
+			__m256i lower = _mm256_or_si256(x, caseBit);
+			__m256i isGap = _mm256_cmpeq_epi8(x, dash);
+			
+			gap = _mm256_or_si256(gap, isGap);
+			same = _mm256_and_si256(same, _mm256_cmpeq_epi8(x, ref));
+			
+			if ( j > 0 )
+			{
+				n = _mm256_or_si256(n, _mm256_cmpeq_epi8(lower, nn));
+			}
+			
+			classes = _mm256_or_si256(classes, _mm256_and_si256(_mm256_cmpeq_epi8(lower, a), bitA));
+			classes = _mm256_or_si256(classes, _mm256_and_si256(_mm256_cmpeq_epi8(lower, c), bitC));
+			classes = _mm256_or_si256(classes, _mm256_and_si256(_mm256_cmpeq_epi8(lower, g), bitG));
+			classes = _mm256_or_si256(classes, _mm256_and_si256(_mm256_cmpeq_epi8(lower, t), bitT));
+			classes = _mm256_or_si256(classes, _mm256_and_si256(isGap, bitGap));
+		}
+		
+		unsigned char sameBytes[32];
+		unsigned char gapBytes[32];
+		unsigned char nBytes[32];
+		unsigned char classBytes[32];
+		
+		_mm256_storeu_si256((__m256i *)sameBytes, same);
+		_mm256_storeu_si256((__m256i *)gapBytes, gap);
+		_mm256_storeu_si256((__m256i *)nBytes, n);
+		_mm256_storeu_si256((__m256i *)classBytes, classes);
+		
+		for ( int k = 0; k < 32; k++ )
+		{
+			flags[i + k] = columnFlags(! sameBytes[k], gapBytes[k], nBytes[k], classBytes[k]);
+		}
+	}
+	
+	return i;
+}
+
+#endif
+
+void scanColumns(const vector<string> & seqs, vector<unsigned char> & flags)
+{
+	int length = seqs.size() ? seqs[0].length() : 0;
+	vector<const char *> rows(seqs.size());
+	int done = 0;
+	
+	for ( int i = 0; i < seqs.size(); i++ )
+	{
+		rows[i] = seqs[i].data();
+	}
+	
+	flags.resize(length);
+	
+	if ( length == 0 )
+	{
+		return;
+	}
+	
+#ifdef SCAN_X86
+	if ( __builtin_cpu_supports("avx2") )
+	{
+		done = scanColumnsAvx2(rows, length, flags.data());
+	}
+	else
+	{
+		done = scanColumnsSse2(rows, length, flags.data());
+	}
+#endif
+	
+	scanColumnsScalar(rows, done, length, flags.data());
+}
@@ -0,0 +1,29 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef scan_h
+#define scan_h
+
+#include <string>
+#include <vector>
+
+// Per-column flags from scanColumns
+//
+enum ColumnFlag
+{
+	COLUMN_variant = 1, // a sequence differs from the first (exact character)
+	COLUMN_gap = 2, // any sequence has a gap
+	COLUMN_n = 4, // a sequence other than the first has N or n
+	COLUMN_conserved = 8, // at most one of A, C, G, T and gap present (any case)
+};
+
+// Classify every column of an alignment (sequences of equal length) in one
+// pass, in tiles of columns across all sequences, using AVX2 or SSE2 where the
+// CPU has them and scalar code otherwise.
+//
+void scanColumns(const std::vector<std::string> & seqs, std::vector<unsigned char> & flags);
+
+#endif
@@ -0,0 +1,453 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#include "harvest/zblock.h"
+#include "harvest/ThreadPool.h"
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace::std;
+
+static const char zblockMagic[] = "HVTBLKIX"; // ends the block index
+static const int zblockMagicLength = 8;
+
+static const size_t zblockChunkMax = 1 << 30; // zlib counts are 32-bit
+
+static uint64_t readLittleEndian64(const unsigned char * data)
+{
+	uint64_t value = 0;
+	
+	for ( int i = 7; i >= 0; i-- )
+	{
+		value = (value << 8) | data[i];
+	}
+	
+	return value;
+}
+
+static void writeLittleEndian64(unsigned char * data, uint64_t value)
+{
+	for ( int i = 0; i < 8; i++ )
+	{
+		data[i] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+bool writeAll(int fd, const unsigned char * data, size_t size)
+{
+	while ( size > 0 )
+	{
+		ssize_t written = write(fd, data, min(size, zblockChunkMax));
+		
+		if ( written < 0 )
+		{
+			return false;
+		}
+		
+		data += written;
+		size -= written;
+	}
+	
+	return true;
+}
+
+static bool readBlockIndex(const unsigned char * data, size_t size, vector<uint64_t> & lengthsIn, vector<uint64_t> & lengthsOut)
+{
+	// zlib header and adler32 trailer surround the blocks
+	//
+	const size_t framing = 2 + 4;
+	
+	if ( size < framing + 8 + zblockMagicLength || memcmp(data + size - zblockMagicLength, zblockMagic, zblockMagicLength) != 0 )
+	{
+		return false;
+	}
+	
+	uint64_t count = readLittleEndian64(data + size - zblockMagicLength - 8);
+	
+	if ( count == 0 || count > (size - framing - 8 - zblockMagicLength) / 16 )
+	{
+		return false;
+	}
+	
+	size_t indexSize = count * 16 + 8 + zblockMagicLength;
+	const unsigned char * index = data + size - indexSize;
+	uint64_t totalIn = 0;
+	
+	lengthsIn.resize(count);
+	lengthsOut.resize(count);
+	
+	for ( uint64_t i = 0; i < count; i++ )
+	{
+		lengthsIn[i] = readLittleEndian64(index + i * 16);
+		lengthsOut[i] = readLittleEndian64(index + i * 16 + 8);
+		totalIn += lengthsIn[i];
+		
+		if ( lengthsIn[i] > UINT_MAX || lengthsOut[i] > UINT_MAX )
+		{
+			return false;
+		}
+	}
+	
+	return totalIn == size - indexSize - framing;
+}
+
+static int inflateBlock(const unsigned char * in, uint64_t lengthIn, unsigned char * out, uint64_t lengthOut)
+{
+	z_stream strm;
+	
+	memset(&strm, 0, sizeof(strm));
+	
+	int ret = inflateInit2(&strm, -MAX_WBITS);
+	
+	if ( ret != Z_OK )
+	{
+		return ret;
+	}
+	
+	strm.next_in = (Bytef *)in;
+	strm.avail_in = lengthIn;
+	strm.next_out = out;
+	strm.avail_out = lengthOut;
+	
+	ret = inflate(&strm, Z_SYNC_FLUSH);
+	
+	if ( strm.avail_out == 0 && strm.avail_in > 0 && (ret == Z_OK || ret == Z_BUF_ERROR) )
+	{
+		// the output is full, but the empty block that ends a flushed run
+		// may not have been read yet; it must not produce anything
+		
+		unsigned char extra;
+		
+		strm.next_out = &extra;
+		strm.avail_out = 1;
+		ret = inflate(&strm, Z_SYNC_FLUSH);
+		
+		if ( strm.avail_out == 0 )
+		{
+			ret = Z_DATA_ERROR;
+		}
+	}
+	
+	if ( ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR )
+	{
+		ret = strm.avail_in == 0 && strm.total_out == lengthOut ? Z_OK : Z_DATA_ERROR;
+	}
+	else if ( ret == Z_NEED_DICT )
+	{
+		ret = Z_DATA_ERROR;
+	}
+	
+	inflateEnd(&strm);
+	return ret;
+}
+
+static int deflateBlock(const vector<pair<const unsigned char *, size_t> > & pieces, uint64_t start, uint64_t length, bool last, int level, vector<unsigned char> & out, uLong & check)
+{
+	z_stream strm;
+	
+	memset(&strm, 0, sizeof(strm));
+	
+	int ret = deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	
+	if ( ret != Z_OK )
+	{
+		return ret;
+	}
+	
+	out.resize(deflateBound(&strm, length) + 16); // room for the flush marker
+	strm.next_out = out.data();
+	strm.avail_out = out.size();
+	check = adler32(0L, Z_NULL, 0);
+	
+	// find the pieces that overlap this block and feed them in order; the
+	// final call flushes (or finishes the stream) even if there is no input
+	
+	uint64_t offset = 0;
+	uint64_t end = start + length;
+	
+	for ( size_t i = 0; i <= pieces.size(); i++ )
+	{
+		const unsigned char * in = 0;
+		uint64_t size = 0;
+		
+		if ( i < pieces.size() )
+		{
+			uint64_t pieceStart = offset;
+			uint64_t pieceEnd = offset + pieces[i].second;
+			
+			offset = pieceEnd;
+			
+			if ( pieceEnd <= start || pieceStart >= end )
+			{
+				continue;
+			}
+			
+			uint64_t from = max(pieceStart, start);
+			
+			in = pieces[i].first + (from - pieceStart);
+			size = min(pieceEnd, end) - from;
+			check = adler32(check, in, size);
+		}
+		
+		int flush = i < pieces.size() ? Z_NO_FLUSH : (last ? Z_FINISH : Z_SYNC_FLUSH);
+		
+		strm.next_in = (Bytef *)in;
+		strm.avail_in = size;
+		
+		do
+		{
+			if ( strm.avail_out == 0 )
+			{
+				size_t used = out.size();
+				
+				out.resize(used * 2);
+				strm.next_out = out.data() + used;
+				strm.avail_out = out.size() - used;
+			}
+			
+			ret = deflate(&strm, flush);
+			
+			if ( ret == Z_STREAM_ERROR )
+			{
+				deflateEnd(&strm);
+				return ret;
+			}
+		}
+		while ( strm.avail_out == 0 || strm.avail_in > 0 );
+	}
+	
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+	
+	return last && ret != Z_STREAM_END ? Z_STREAM_ERROR : Z_OK;
+}
+
+static int inflateStream(const unsigned char * data, size_t size, vector<uint64_t> & words)
+{
+	// the uncompressed size is unknown, so grow the output as we go
+	
+	z_stream strm;
+	int ret;
+	size_t consumed = 0;
+	size_t produced = 0;
+	
+	memset(&strm, 0, sizeof(strm));
+	ret = inflateInit(&strm);
+	
+	if ( ret != Z_OK )
+	{
+		return ret;
+	}
+	
+	words.resize(size / 2 + 1);
+	
+	do
+	{
+		if ( strm.avail_in == 0 )
+		{
+			size_t chunk = min(size - consumed, zblockChunkMax);
+			
+			strm.next_in = (Bytef *)(data + consumed);
+			strm.avail_in = chunk;
+			consumed += chunk;
+		}
+		
+		if ( produced == words.size() * 8 )
+		{
+			words.resize(words.size() * 2);
+		}
+		
+		size_t room = min(words.size() * 8 - produced, zblockChunkMax);
+		
+		strm.next_out = (Bytef *)words.data() + produced;
+		strm.avail_out = room;
+		
+		ret = inflate(&strm, Z_NO_FLUSH);
+		produced += room - strm.avail_out;
+		
+		if ( ret == Z_NEED_DICT || (ret == Z_BUF_ERROR && strm.avail_in == 0 && consumed == size) )
+		{
+			ret = Z_DATA_ERROR; // truncated or needs a dictionary we don't have
+		}
+		
+		if ( ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_STREAM_ERROR )
+		{
+			inflateEnd(&strm);
+			return ret;
+		}
+	}
+	while ( ret != Z_STREAM_END );
+	
+	inflateEnd(&strm);
+	
+	words.resize((produced + 7) / 8);
+	memset((char *)words.data() + produced, 0, words.size() * 8 - produced);
+	
+	return Z_OK;
+}
+
+int inflateBlocks(const unsigned char * data, size_t size, vector<uint64_t> & words, int threads)
+{
+	vector<uint64_t> lengthsIn;
+	vector<uint64_t> lengthsOut;
+	
+	if ( ! readBlockIndex(data, size, lengthsIn, lengthsOut) )
+	{
+		return inflateStream(data, size, words);
+	}
+	
+	if ( (data[0] & 0x0f) != Z_DEFLATED || (data[0] * 256 + data[1]) % 31 != 0 || data[1] & 0x20 )
+	{
+		return Z_DATA_ERROR;
+	}
+	
+	int count = lengthsIn.size();
+	vector<uint64_t> offsetsIn(count);
+	vector<uint64_t> offsetsOut(count);
+	uint64_t totalIn = 0;
+	uint64_t totalOut = 0;
+	
+	for ( int i = 0; i < count; i++ )
+	{
+		offsetsIn[i] = 2 + totalIn;
+		offsetsOut[i] = totalOut;
+		totalIn += lengthsIn[i];
+		totalOut += lengthsOut[i];
+	}
+	
+	words.resize(0);
+	words.resize((totalOut + 7) / 8, 0);
+	
+	unsigned char * out = (unsigned char *)words.data();
+	vector<int> results(count);
+	vector<uLong> checks(count);
+	ThreadPool threadPool(threads);
+	
+	for ( int i = 0; i < count; i++ )
+	{
+		threadPool.run([&, i]()
+		{
+			results[i] = inflateBlock(data + offsetsIn[i], lengthsIn[i], out + offsetsOut[i], lengthsOut[i]);
+			checks[i] = adler32(adler32(0L, Z_NULL, 0), out + offsetsOut[i], lengthsOut[i]);
+		});
+	}
+	
+	threadPool.wait();
+	
+	uLong check = adler32(0L, Z_NULL, 0);
+	
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( results[i] != Z_OK )
+		{
+			return results[i];
+		}
+		
+		check = adler32_combine(check, checks[i], lengthsOut[i]);
+	}
+	
+	const unsigned char * trailer = data + 2 + totalIn;
+	uLong checkStream = ((uLong)trailer[0] << 24) | ((uLong)trailer[1] << 16) | ((uLong)trailer[2] << 8) | trailer[3];
+	
+	return check == checkStream ? Z_OK : Z_DATA_ERROR;
+}
+
+int deflateBlocks(const vector<pair<const unsigned char *, size_t> > & pieces, int fd, int level, int threads)
+{
+	uint64_t total = 0;
+	
+	for ( size_t i = 0; i < pieces.size(); i++ )
+	{
+		total += pieces[i].second;
+	}
+	
+	uint64_t count = total == 0 ? 1 : (total + zblockSize - 1) / zblockSize;
+	vector<uint64_t> lengthsIn(count);
+	vector<uint64_t> lengthsOut(count);
+	uLong check = adler32(0L, Z_NULL, 0);
+	
+	// zlib header, with the level hint that deflateInit() would write
+	
+	int levelFlag = level == Z_DEFAULT_COMPRESSION || level == 6 ? 2 : (level < 2 ? 0 : (level < 6 ? 1 : 3));
+	unsigned char header[2] = {0x78, (unsigned char)(levelFlag << 6)};
+	
+	header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+	
+	if ( ! writeAll(fd, header, 2) )
+	{
+		return Z_ERRNO;
+	}
+	
+	// compress a batch of blocks at a time so memory stays bounded while
+	// output is still written in block order
+	
+	ThreadPool threadPool(threads);
+	uint64_t batch = threadPool.getThreadCount() * 4;
+	vector<vector<unsigned char> > outs(min(batch, count));
+	vector<uLong> checks(outs.size());
+	vector<int> results(outs.size());
+	
+	for ( uint64_t first = 0; first < count; first += batch )
+	{
+		uint64_t last = min(first + batch, count);
+		
+		for ( uint64_t i = first; i < last; i++ )
+		{
+			threadPool.run([&, i, first]()
+			{
+				uint64_t start = i * zblockSize;
+				uint64_t length = min(total - start, (uint64_t)zblockSize);
+				
+				results[i - first] = deflateBlock(pieces, start, length, i == count - 1, level, outs[i - first], checks[i - first]);
+				lengthsOut[i] = length;
+			});
+		}
+		
+		threadPool.wait();
+		
+		for ( uint64_t i = first; i < last; i++ )
+		{
+			if ( results[i - first] != Z_OK )
+			{
+				return results[i - first];
+			}
+			
+			const vector<unsigned char> & out = outs[i - first];
+			
+			if ( ! writeAll(fd, out.data(), out.size()) )
+			{
+				return Z_ERRNO;
+			}
+			
+			lengthsIn[i] = out.size();
+			check = adler32_combine(check, checks[i - first], lengthsOut[i]);
+		}
+	}
+	
+	// adler32 trailer (big endian) ends the zlib stream; the index follows
+	
+	vector<unsigned char> index(4 + count * 16 + 8 + zblockMagicLength);
+	
+	index[0] = check >> 24;
+	index[1] = check >> 16;
+	index[2] = check >> 8;
+	index[3] = check;
+	
+	for ( uint64_t i = 0; i < count; i++ )
+	{
+		writeLittleEndian64(index.data() + 4 + i * 16, lengthsIn[i]);
+		writeLittleEndian64(index.data() + 4 + i * 16 + 8, lengthsOut[i]);
+	}
+	
+	writeLittleEndian64(index.data() + 4 + count * 16, count);
+	memcpy(index.data() + 4 + count * 16 + 8, zblockMagic, zblockMagicLength);
+	
+	return writeAll(fd, index.data(), index.size()) ? Z_OK : Z_ERRNO;
+}
@@ -0,0 +1,46 @@
+// Copyright © 2014, Battelle National Biodefense Institute (BNBI);
+// all rights reserved. Authored by: Brian Ondov, Todd Treangen, and
+// Adam Phillippy
+//
+// See the LICENSE.txt file included with this software for license information.
+
+#ifndef zblock_h
+#define zblock_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Compressed Cap'n Proto Harvest files are a header followed by a single zlib
+// stream. The stream may be made of independently compressed blocks (each a
+// raw deflate run flushed to a byte boundary, with no back-references into
+// earlier blocks), in which case a block index follows the zlib stream:
+//
+//   for each block: compressed length, uncompressed length (uint64 LE)
+//   block count (uint64 LE)
+//   "HVTBLKIX"
+//
+// Readers that don't know about the index stop at the end of the zlib stream,
+// so block-compressed files remain ordinary zlib data.
+
+static const size_t zblockSize = 1 << 20; // uncompressed bytes per block
+
+// Inflate a complete zlib stream from memory into 8-byte words, padding the
+// last word with zeros. If a block index is present, blocks are inflated in
+// parallel with the given number of threads. Returns a zlib status code.
+//
+int inflateBlocks(const unsigned char * data, size_t size, std::vector<uint64_t> & words, int threads);
+
+// Deflate the concatenation of the given pieces to a file descriptor as a
+// block-compressed zlib stream followed by its block index. Blocks are
+// compressed in parallel with the given number of threads and written in
+// order. Returns a zlib status code (Z_ERRNO if writing fails).
+//
+int deflateBlocks(const std::vector<std::pair<const unsigned char *, size_t> > & pieces, int fd, int level, int threads);
+
+// Write a whole buffer to a file descriptor, continuing after short writes.
+//
+bool writeAll(int fd, const unsigned char * data, size_t size);
+
+#endif